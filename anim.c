@@ -0,0 +1,423 @@
+#include "anim.h"
+#include "job.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE__
+# include <xmmintrin.h>
+#endif
+
+#define ROT_SCALE 32767.0f
+#define VEC_SCALE 65535.0f
+#define CONST_EPSILON 1e-5f
+
+static int16_t
+quantize_snorm(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (int16_t)(v * ROT_SCALE + (v < 0 ? -0.5f : 0.5f));
+}
+
+static uint16_t
+quantize_unorm(float v, float min, float extent)
+{
+	if (extent <= 0.0f) {
+		return 0;
+	}
+	float n = (v - min) / extent;
+	n = n < 0.0f ? 0.0f : (n > 1.0f ? 1.0f : n);
+	return (uint16_t)(n * VEC_SCALE + 0.5f);
+}
+
+static int
+rot_constant(const AnimTransform *frames, unsigned frame_count, unsigned joint_count, unsigned joint)
+{
+	const Qtr *first = &frames[joint].rot;
+	for (unsigned f = 1; f < frame_count; f++) {
+		float d = qtr_dot(first, &frames[f * joint_count + joint].rot);
+		if (fabs(d) < 1.0f - CONST_EPSILON) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void
+vec_range(
+	const AnimTransform *frames,
+	unsigned frame_count,
+	unsigned joint_count,
+	unsigned joint,
+	size_t member,
+	float *r_min,
+	float *r_extent
+) {
+	float max[3];
+	for (unsigned f = 0; f < frame_count; f++) {
+		const char *t = (const char*)&frames[f * joint_count + joint];
+		const Vec *v = (const Vec*)(t + member);
+		for (int c = 0; c < 3; c++) {
+			if (f == 0 || v->data[c] < r_min[c]) {
+				r_min[c] = v->data[c];
+			}
+			if (f == 0 || v->data[c] > max[c]) {
+				max[c] = v->data[c];
+			}
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		r_extent[c] = max[c] - r_min[c];
+		if (r_extent[c] < CONST_EPSILON) {
+			r_extent[c] = 0.0f;
+		}
+	}
+}
+
+static int
+vec_constant(const float *extent)
+{
+	return extent[0] == 0.0f && extent[1] == 0.0f && extent[2] == 0.0f;
+}
+
+static void
+store_vec_keys(
+	uint16_t *keys,
+	const AnimTransform *frames,
+	unsigned count,
+	unsigned joint_count,
+	unsigned joint,
+	size_t member,
+	const float *min,
+	const float *extent
+) {
+	for (unsigned f = 0; f < count; f++) {
+		const char *t = (const char*)&frames[f * joint_count + joint];
+		const Vec *v = (const Vec*)(t + member);
+		for (int c = 0; c < 3; c++) {
+			keys[f * 3 + c] = quantize_unorm(v->data[c], min[c], extent[c]);
+		}
+	}
+}
+
+int
+anim_clip_build(
+	AnimClip *clip,
+	const AnimTransform *frames,
+	unsigned frame_count,
+	unsigned joint_count,
+	float rate
+) {
+	memset(clip, 0, sizeof(AnimClip));
+	if (frame_count == 0 || frame_count > UINT16_MAX ||
+	    joint_count == 0 || joint_count > ANIM_MAX_JOINTS || rate <= 0) {
+		return 0;
+	}
+
+	clip->tracks = calloc(joint_count, sizeof(AnimTrack));
+	if (!clip->tracks) {
+		return 0;
+	}
+	clip->frame_count = frame_count;
+	clip->track_count = joint_count;
+	clip->rate = rate;
+	clip->duration = (frame_count - 1) / rate;
+
+	// first pass: pick the key count of each channel and compute offsets
+	unsigned rot_total = 0, vec_total = 0;
+	for (unsigned j = 0; j < joint_count; j++) {
+		AnimTrack *track = &clip->tracks[j];
+
+		track->rot_count = rot_constant(frames, frame_count, joint_count, j) ? 1 : frame_count;
+		track->rot_offset = rot_total;
+		rot_total += track->rot_count * 4;
+
+		vec_range(frames, frame_count, joint_count, j, offsetof(AnimTransform, pos), track->pos_min, track->pos_extent);
+		track->pos_count = vec_constant(track->pos_extent) ? 1 : frame_count;
+		track->pos_offset = vec_total;
+		vec_total += track->pos_count * 3;
+
+		vec_range(frames, frame_count, joint_count, j, offsetof(AnimTransform, scale), track->scale_min, track->scale_extent);
+		track->scale_count = vec_constant(track->scale_extent) ? 1 : frame_count;
+		track->scale_offset = vec_total;
+		vec_total += track->scale_count * 3;
+	}
+
+	clip->rot_keys = malloc(rot_total * sizeof(int16_t));
+	clip->vec_keys = malloc(vec_total * sizeof(uint16_t));
+	if (!clip->rot_keys || !clip->vec_keys) {
+		anim_clip_free(clip);
+		return 0;
+	}
+
+	// second pass: quantize the keys
+	for (unsigned j = 0; j < joint_count; j++) {
+		const AnimTrack *track = &clip->tracks[j];
+
+		int16_t *rk = clip->rot_keys + track->rot_offset;
+		Qtr prev = frames[j].rot;
+		for (unsigned f = 0; f < track->rot_count; f++) {
+			// keep consecutive keys in the same hemisphere so that
+			// interpolation takes the shortest path
+			Qtr q = frames[f * joint_count + j].rot;
+			if (qtr_dot(&prev, &q) < 0) {
+				qtr_imulf(&q, -1.0f);
+			}
+			qtr_norm(&q);
+			for (int c = 0; c < 4; c++) {
+				rk[f * 4 + c] = quantize_snorm(q.data[c]);
+			}
+			prev = q;
+		}
+
+		store_vec_keys(
+			clip->vec_keys + track->pos_offset,
+			frames,
+			track->pos_count,
+			joint_count,
+			j,
+			offsetof(AnimTransform, pos),
+			track->pos_min,
+			track->pos_extent
+		);
+		store_vec_keys(
+			clip->vec_keys + track->scale_offset,
+			frames,
+			track->scale_count,
+			joint_count,
+			j,
+			offsetof(AnimTransform, scale),
+			track->scale_min,
+			track->scale_extent
+		);
+	}
+
+	return 1;
+}
+
+void
+anim_clip_free(AnimClip *clip)
+{
+	free(clip->tracks);
+	free(clip->rot_keys);
+	free(clip->vec_keys);
+	memset(clip, 0, sizeof(AnimClip));
+}
+
+unsigned
+anim_clip_size(const AnimClip *clip)
+{
+	unsigned size = clip->track_count * sizeof(AnimTrack);
+	for (unsigned j = 0; j < clip->track_count; j++) {
+		const AnimTrack *track = &clip->tracks[j];
+		size += track->rot_count * 4 * sizeof(int16_t);
+		size += (track->pos_count + track->scale_count) * 3 * sizeof(uint16_t);
+	}
+	return size;
+}
+
+static Qtr
+decode_rot(const int16_t *keys, unsigned frame)
+{
+	const int16_t *k = keys + frame * 4;
+	return qtr(k[0] / ROT_SCALE, k[1] / ROT_SCALE, k[2] / ROT_SCALE, k[3] / ROT_SCALE);
+}
+
+static Vec
+decode_vec(const uint16_t *keys, unsigned frame, const float *min, const float *extent)
+{
+	const uint16_t *k = keys + frame * 3;
+	return vec(
+		min[0] + k[0] / VEC_SCALE * extent[0],
+		min[1] + k[1] / VEC_SCALE * extent[1],
+		min[2] + k[2] / VEC_SCALE * extent[2],
+		0
+	);
+}
+
+static void
+sample_vec(
+	const uint16_t *keys,
+	unsigned count,
+	unsigned f0,
+	unsigned f1,
+	float t,
+	const float *min,
+	const float *extent,
+	Vec *r_v
+) {
+	if (count == 1) {
+		*r_v = decode_vec(keys, 0, min, extent);
+		return;
+	}
+	Vec a = decode_vec(keys, f0, min, extent);
+	Vec b = decode_vec(keys, f1, min, extent);
+	vec_lerp(&a, &b, t, r_v);
+}
+
+void
+anim_clip_sample(
+	const AnimClip *clip,
+	float time,
+	int loop,
+	AnimTransform *r_local
+) {
+	if (loop && clip->duration > 0) {
+		time = fmodf(time, clip->duration);
+		if (time < 0) {
+			time += clip->duration;
+		}
+	} else {
+		time = time < 0 ? 0 : (time > clip->duration ? clip->duration : time);
+	}
+
+	float f = time * clip->rate;
+	unsigned f0 = (unsigned)f;
+	if (f0 >= clip->frame_count - 1) {
+		f0 = clip->frame_count - 1;
+	}
+	unsigned f1 = f0 + 1 < clip->frame_count ? f0 + 1 : f0;
+	float t = f - f0;
+
+	for (unsigned j = 0; j < clip->track_count; j++) {
+		const AnimTrack *track = &clip->tracks[j];
+		AnimTransform *local = &r_local[j];
+
+		const int16_t *rk = clip->rot_keys + track->rot_offset;
+		if (track->rot_count == 1) {
+			local->rot = decode_rot(rk, 0);
+			qtr_norm(&local->rot);
+		} else {
+			Qtr a = decode_rot(rk, f0);
+			Qtr b = decode_rot(rk, f1);
+			if (qtr_dot(&a, &b) < 0) {
+				qtr_imulf(&b, -1.0f);
+			}
+			qtr_lerp(&a, &b, t, &local->rot);
+		}
+
+		sample_vec(
+			clip->vec_keys + track->pos_offset,
+			track->pos_count,
+			f0, f1, t,
+			track->pos_min,
+			track->pos_extent,
+			&local->pos
+		);
+		local->pos.data[3] = 1.0f;
+		sample_vec(
+			clip->vec_keys + track->scale_offset,
+			track->scale_count,
+			f0, f1, t,
+			track->scale_min,
+			track->scale_extent,
+			&local->scale
+		);
+	}
+}
+
+void
+anim_pose_model(const Skeleton *skel, const AnimTransform *local, Mat *r_model)
+{
+	for (unsigned j = 0; j < skel->joint_count; j++) {
+		const AnimTransform *t = &local[j];
+		int parent = skel->parents[j];
+		if (parent < 0) {
+			mat_compose(&r_model[j], &t->pos, &t->rot, &t->scale);
+		} else {
+			Mat lm;
+			mat_compose(&lm, &t->pos, &t->rot, &t->scale);
+			mat_mul(&r_model[parent], &lm, &r_model[j]);
+		}
+	}
+}
+
+void
+anim_pose_palette(const Skeleton *skel, const Mat *model, Mat *r_palette)
+{
+	for (unsigned j = 0; j < skel->joint_count; j++) {
+		mat_mul(&model[j], &skel->inv_bind[j], &r_palette[j]);
+	}
+}
+
+static void
+update_job(void *data, unsigned begin, unsigned end)
+{
+	AnimInstance *instances = data;
+	for (unsigned i = begin; i < end; i++) {
+		AnimInstance *inst = &instances[i];
+		anim_clip_sample(inst->clip, inst->time, inst->loop, inst->local);
+		anim_pose_model(inst->skel, inst->local, inst->model);
+		anim_pose_palette(inst->skel, inst->model, inst->palette);
+	}
+}
+
+void
+anim_update(AnimInstance *instances, unsigned count)
+{
+	job_parallel_for(count, 16, update_job, instances);
+}
+
+void
+anim_skin(
+	const Mat *palette,
+	const SkinVertex *verts,
+	unsigned count,
+	float *r_pos,
+	float *r_normal
+) {
+	for (unsigned i = 0; i < count; i++) {
+		const SkinVertex *v = &verts[i];
+#ifdef __SSE__
+		// blend the joint matrices row by row, then transpose them so that
+		// the transform becomes a sum of scaled columns
+		__m128 r0 = _mm_setzero_ps(), r1 = r0, r2 = r0, r3 = r0;
+		for (int k = 0; k < 4; k++) {
+			const float *m = palette[v->joints[k]].data;
+			__m128 w = _mm_set1_ps(v->weights[k]);
+			r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(m)));
+			r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+			r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+		}
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		float out[4];
+		__m128 p = _mm_add_ps(
+			_mm_add_ps(
+				_mm_mul_ps(r0, _mm_set1_ps(v->pos[0])),
+				_mm_mul_ps(r1, _mm_set1_ps(v->pos[1]))
+			),
+			_mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(v->pos[2])), r3)
+		);
+		_mm_storeu_ps(out, p);
+		memcpy(r_pos + i * 3, out, 3 * sizeof(float));
+
+		if (r_normal) {
+			__m128 n = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(r0, _mm_set1_ps(v->normal[0])),
+					_mm_mul_ps(r1, _mm_set1_ps(v->normal[1]))
+				),
+				_mm_mul_ps(r2, _mm_set1_ps(v->normal[2]))
+			);
+			_mm_storeu_ps(out, n);
+			memcpy(r_normal + i * 3, out, 3 * sizeof(float));
+		}
+#else
+		float m[12] = { 0 };
+		for (int k = 0; k < 4; k++) {
+			const float *pm = palette[v->joints[k]].data;
+			for (int e = 0; e < 12; e++) {
+				m[e] += v->weights[k] * pm[e];
+			}
+		}
+		for (int r = 0; r < 3; r++) {
+			const float *row = m + r * 4;
+			r_pos[i * 3 + r] = row[0] * v->pos[0] + row[1] * v->pos[1] + row[2] * v->pos[2] + row[3];
+			if (r_normal) {
+				r_normal[i * 3 + r] = row[0] * v->normal[0] + row[1] * v->normal[1] + row[2] * v->normal[2];
+			}
+		}
+#endif
+	}
+}
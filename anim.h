@@ -0,0 +1,179 @@
+#pragma once
+
+#include "matlib.h"
+#include <stdint.h>
+
+#define ANIM_MAX_JOINTS 128
+
+typedef struct AnimTransform AnimTransform;
+typedef struct AnimTrack AnimTrack;
+typedef struct AnimClip AnimClip;
+typedef struct Skeleton Skeleton;
+typedef struct SkinVertex SkinVertex;
+typedef struct AnimInstance AnimInstance;
+
+
+/*******************************************************************************
+ * Joint hierarchy.
+*******************************************************************************/
+
+/**
+ * AnimTransform - Local joint transform.
+ */
+struct AnimTransform {
+	Vec pos;
+	Qtr rot;
+	Vec scale;
+};
+
+/**
+ * Skeleton - Joint hierarchy in bind pose.
+ *
+ * Joints are sorted so that every parent comes before its children; root
+ * joints have parent -1.
+ */
+struct Skeleton {
+	unsigned joint_count;
+	int parents[ANIM_MAX_JOINTS];
+	Mat inv_bind[ANIM_MAX_JOINTS];
+};
+
+
+/*******************************************************************************
+ * Animation clips.
+*******************************************************************************/
+
+/**
+ * AnimTrack - Quantized keys of a single joint.
+ *
+ * Each channel stores either one key per clip frame or, when the channel does
+ * not change over the clip, a single constant key. Rotations are stored as
+ * four signed 16-bit components, translations and scales as three unsigned
+ * 16-bit components normalized to the [min, min + extent] range of the track.
+ */
+struct AnimTrack {
+	uint16_t rot_count;
+	uint16_t pos_count;
+	uint16_t scale_count;
+	uint32_t rot_offset;
+	uint32_t pos_offset;
+	uint32_t scale_offset;
+	float pos_min[3], pos_extent[3];
+	float scale_min[3], scale_extent[3];
+};
+
+/**
+ * AnimClip - Uniformly sampled, quantized animation of a skeleton.
+ */
+struct AnimClip {
+	float duration;
+	float rate;
+	unsigned frame_count;
+	unsigned track_count;
+	AnimTrack *tracks;
+	int16_t *rot_keys;
+	uint16_t *vec_keys;
+};
+
+/**
+ * Build a clip out of `frame_count` poses of `joint_count` joints each,
+ * sampled at `rate` frames per second.
+ *
+ * `frames` is laid out frame after frame. Returns 1 on success, 0 on failure.
+ */
+int
+anim_clip_build(
+	AnimClip *clip,
+	const AnimTransform *frames,
+	unsigned frame_count,
+	unsigned joint_count,
+	float rate
+);
+
+void
+anim_clip_free(AnimClip *clip);
+
+/**
+ * Size of the clip key data in bytes.
+ */
+unsigned
+anim_clip_size(const AnimClip *clip);
+
+/**
+ * Sample the local pose of all joints at given time.
+ */
+void
+anim_clip_sample(
+	const AnimClip *clip,
+	float time,
+	int loop,
+	AnimTransform *r_local
+);
+
+
+/*******************************************************************************
+ * Pose evaluation.
+*******************************************************************************/
+
+/**
+ * Accumulate local joint transforms into model-space transforms.
+ */
+void
+anim_pose_model(const Skeleton *skel, const AnimTransform *local, Mat *r_model);
+
+/**
+ * Compute skinning matrices out of model-space joint transforms.
+ */
+void
+anim_pose_palette(const Skeleton *skel, const Mat *model, Mat *r_palette);
+
+/**
+ * AnimInstance - Animated character state.
+ */
+struct AnimInstance {
+	const Skeleton *skel;
+	const AnimClip *clip;
+	float time;
+	int loop;
+	AnimTransform local[ANIM_MAX_JOINTS];
+	Mat model[ANIM_MAX_JOINTS];
+	Mat palette[ANIM_MAX_JOINTS];
+};
+
+/**
+ * Sample, accumulate and compute palettes of many instances on the worker
+ * threads.
+ */
+void
+anim_update(AnimInstance *instances, unsigned count);
+
+
+/*******************************************************************************
+ * CPU skinning.
+*******************************************************************************/
+
+/**
+ * SkinVertex - Vertex bound to up to four joints.
+ */
+struct SkinVertex {
+	float pos[3];
+	float normal[3];
+	uint8_t joints[4];
+	float weights[4];
+};
+
+/**
+ * Transform vertices by the weighted sum of their joints palette matrices.
+ *
+ * Writes three floats per vertex to `r_pos` and `r_normal`; `r_normal` may be
+ * NULL. Reference path for headless use and testing, the renderer does the
+ * same in the vertex shader.
+ */
+void
+anim_skin(
+	const Mat *palette,
+	const SkinVertex *verts,
+	unsigned count,
+	float *r_pos,
+	float *r_normal
+);
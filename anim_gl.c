@@ -0,0 +1,119 @@
+#include "anim_gl.h"
+#include <stddef.h>
+#include <string.h>
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+const char *anim_gl_skin_vs =
+	"#version 330 core\n"
+	"layout(location = 0) in vec3 position;\n"
+	"layout(location = 1) in vec3 normal;\n"
+	"layout(location = 2) in uvec4 joints;\n"
+	"layout(location = 3) in vec4 weights;\n"
+	"layout(std140, row_major) uniform Palette {\n"
+	"	mat4 palette[" XSTR(ANIM_MAX_JOINTS) "];\n"
+	"};\n"
+	"uniform mat4 view_proj;\n"
+	"out vec3 v_normal;\n"
+	"void main() {\n"
+	"	mat4 skin = weights.x * palette[joints.x] +\n"
+	"	            weights.y * palette[joints.y] +\n"
+	"	            weights.z * palette[joints.z] +\n"
+	"	            weights.w * palette[joints.w];\n"
+	"	v_normal = mat3(skin) * normal;\n"
+	"	gl_Position = view_proj * skin * vec4(position, 1.0);\n"
+	"}\n";
+
+int
+anim_gl_init(AnimPaletteBuffer *buf, unsigned capacity, unsigned joint_count)
+{
+	GLint align = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+
+	memset(buf, 0, sizeof(AnimPaletteBuffer));
+	buf->capacity = capacity;
+	buf->joint_count = joint_count;
+	buf->stride = joint_count * sizeof(Mat);
+	buf->stride = (buf->stride + align - 1) / align * align;
+
+	// the bound range must cover the whole palette block even for smaller
+	// skeletons: ranges of consecutive instances overlap, and the buffer
+	// extends past the last palette so that its range stays in bounds
+	glGenBuffers(1, &buf->ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, buf->ubo);
+	glBufferData(
+		GL_UNIFORM_BUFFER,
+		buf->stride * (capacity ? capacity - 1 : 0) + ANIM_MAX_JOINTS * sizeof(Mat),
+		NULL,
+		GL_STREAM_DRAW
+	);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void
+anim_gl_free(AnimPaletteBuffer *buf)
+{
+	glDeleteBuffers(1, &buf->ubo);
+	memset(buf, 0, sizeof(AnimPaletteBuffer));
+}
+
+void
+anim_gl_upload(AnimPaletteBuffer *buf, const AnimInstance *instances, unsigned count)
+{
+	if (count > buf->capacity) {
+		count = buf->capacity;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buf->ubo);
+
+	// orphan the previous storage so that we don't wait for draws still
+	// reading from it
+	char *dst = glMapBufferRange(
+		GL_UNIFORM_BUFFER,
+		0,
+		buf->stride * count,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+	);
+	if (dst) {
+		for (unsigned i = 0; i < count; i++) {
+			unsigned joints = instances[i].skel->joint_count;
+			if (joints > buf->joint_count) {
+				joints = buf->joint_count;
+			}
+			memcpy(dst + buf->stride * i, instances[i].palette, joints * sizeof(Mat));
+		}
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void
+anim_gl_bind(const AnimPaletteBuffer *buf, unsigned instance)
+{
+	glBindBufferRange(
+		GL_UNIFORM_BUFFER,
+		ANIM_PALETTE_BINDING,
+		buf->ubo,
+		buf->stride * instance,
+		ANIM_MAX_JOINTS * sizeof(Mat)
+	);
+}
+
+void
+anim_gl_vertex_layout(GLuint vbo)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, pos));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, joints));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, weights));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "anim.h"
+#include <GL/glew.h>
+
+/**
+ * AnimPaletteBuffer - Uniform buffer holding the skinning palettes of many
+ * animated instances.
+ */
+typedef struct AnimPaletteBuffer {
+	GLuint ubo;
+	unsigned capacity;
+	unsigned joint_count;
+	GLsizeiptr stride;
+} AnimPaletteBuffer;
+
+/**
+ * Vertex shader doing linear blend skinning.
+ *
+ * Expects `position`, `normal`, `joints` and `weights` attributes at
+ * locations 0 to 3 and the palette block bound to ANIM_PALETTE_BINDING.
+ */
+extern const char *anim_gl_skin_vs;
+
+#define ANIM_PALETTE_BINDING 0
+
+/**
+ * Allocate palette storage for `capacity` instances of up to `joint_count`
+ * joints. Returns 1 on success, 0 on failure.
+ */
+int
+anim_gl_init(AnimPaletteBuffer *buf, unsigned capacity, unsigned joint_count);
+
+void
+anim_gl_free(AnimPaletteBuffer *buf);
+
+/**
+ * Upload the palettes of all instances in a single buffer update.
+ */
+void
+anim_gl_upload(AnimPaletteBuffer *buf, const AnimInstance *instances, unsigned count);
+
+/**
+ * Bind the palette of given instance to ANIM_PALETTE_BINDING.
+ */
+void
+anim_gl_bind(const AnimPaletteBuffer *buf, unsigned instance);
+
+/**
+ * Bind the skinning attributes of SkinVertex arrays stored in `vbo` to the
+ * currently bound VAO.
+ */
+void
+anim_gl_vertex_layout(GLuint vbo);
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+# include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define HAVE_TSC 1
+#else
+# define HAVE_TSC 0
+#endif
+
+#define MAX_RESULTS 256
+#define MAX_SAMPLES 15
+
+typedef struct BenchResult {
+	const char *name;
+	unsigned items;
+	double ns_per_op;
+	double cycles_per_op;
+	double ops_per_sec;
+	double spread;
+} BenchResult;
+
+static struct {
+	int cpu;
+	const char *json;
+	const char *filter;
+	double warmup_time;
+	double sample_time;
+	unsigned samples;
+	BenchResult results[MAX_RESULTS];
+	unsigned count;
+} bench = {
+	0, NULL, NULL, 0.2, 0.02, 11
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long
+cycles(void)
+{
+#if HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int
+pin(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return 0;
+#endif
+}
+
+int
+bench_init(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+			bench.cpu = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			bench.json = argv[++i];
+		} else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			bench.filter = argv[++i];
+		} else if (strcmp(argv[i], "--quick") == 0) {
+			bench.warmup_time = 0.02;
+			bench.sample_time = 0.005;
+			bench.samples = 5;
+		} else {
+			fprintf(stderr, "usage: %s [--cpu N] [--json FILE] [--filter STR] [--quick]\n", argv[0]);
+			return 0;
+		}
+	}
+
+	if (bench.cpu >= 0 && !pin(bench.cpu)) {
+		fprintf(stderr, "warning: failed to pin to CPU %d\n", bench.cpu);
+	}
+
+	fprintf(
+		stderr,
+		"%-32s %10s %10s %14s %8s\n",
+		"benchmark", "ns/op", "cycles/op", "ops/s", "spread"
+	);
+	return 1;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+void
+bench_run(const char *name, unsigned items, BenchFunc fn, void *state)
+{
+	if (bench.filter && !strstr(name, bench.filter)) {
+		return;
+	}
+	if (bench.count == MAX_RESULTS) {
+		fprintf(stderr, "too many benchmarks, skipping %s\n", name);
+		return;
+	}
+
+	// warm up caches, branch predictors and clocks while looking for an
+	// iteration count filling a sample
+	unsigned long iters = 1;
+	double elapsed = 0, start = now();
+	while (now() - start < bench.warmup_time || elapsed < bench.sample_time / 2) {
+		double t = now();
+		fn(state, iters);
+		elapsed = now() - t;
+		if (elapsed < bench.sample_time / 2) {
+			iters *= 2;
+		}
+	}
+	if (elapsed > 0) {
+		iters = (unsigned long)(iters * bench.sample_time / elapsed) + 1;
+	}
+
+	double ns[MAX_SAMPLES], cyc[MAX_SAMPLES];
+	for (unsigned s = 0; s < bench.samples; s++) {
+		double t = now();
+		unsigned long long c = cycles();
+		fn(state, iters);
+		c = cycles() - c;
+		t = now() - t;
+
+		ns[s] = t * 1e9 / ((double)iters * items);
+		cyc[s] = (double)c / ((double)iters * items);
+	}
+	qsort(ns, bench.samples, sizeof(double), compare_double);
+	qsort(cyc, bench.samples, sizeof(double), compare_double);
+
+	BenchResult *r = &bench.results[bench.count++];
+	r->name = name;
+	r->items = items;
+	r->ns_per_op = ns[bench.samples / 2];
+	r->cycles_per_op = cyc[bench.samples / 2];
+	r->ops_per_sec = r->ns_per_op > 0 ? 1e9 / r->ns_per_op : 0;
+	r->spread = (ns[bench.samples - 1] - ns[0]) / r->ns_per_op;
+
+	fprintf(
+		stderr,
+		"%-32s %10.2f %10.2f %14.4g %7.1f%%\n",
+		r->name, r->ns_per_op, r->cycles_per_op, r->ops_per_sec, r->spread * 100
+	);
+}
+
+static void
+write_json(FILE *out)
+{
+	fprintf(out, "{\n");
+	fprintf(out, "  \"context\": {\n");
+	fprintf(out, "    \"cpu\": %d,\n", bench.cpu);
+	fprintf(out, "    \"samples\": %u,\n", bench.samples);
+	fprintf(out, "    \"cycle_counter\": \"%s\"\n", HAVE_TSC ? "tsc" : "none");
+	fprintf(out, "  },\n");
+	fprintf(out, "  \"benchmarks\": [\n");
+	for (unsigned i = 0; i < bench.count; i++) {
+		const BenchResult *r = &bench.results[i];
+		fprintf(
+			out,
+			"    {\"name\": \"%s\", \"items\": %u, \"ns_per_op\": %.4f, "
+			"\"cycles_per_op\": %.4f, \"ops_per_sec\": %.6g, \"spread\": %.4f}%s\n",
+			r->name, r->items, r->ns_per_op, r->cycles_per_op,
+			r->ops_per_sec, r->spread, i + 1 < bench.count ? "," : ""
+		);
+	}
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+}
+
+int
+bench_finish(void)
+{
+	if (!bench.json) {
+		return EXIT_SUCCESS;
+	}
+
+	FILE *out = strcmp(bench.json, "-") == 0 ? stdout : fopen(bench.json, "w");
+	if (!out) {
+		perror(bench.json);
+		return EXIT_FAILURE;
+	}
+	write_json(out);
+	if (out != stdout) {
+		fclose(out);
+	}
+	return EXIT_SUCCESS;
+}
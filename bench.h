@@ -0,0 +1,60 @@
+#pragma once
+
+/*******************************************************************************
+ * Microbenchmark harness.
+ *
+ * Each benchmark is a function running an operation a given number of times.
+ * The harness pins the process to a core, warms the operation up, calibrates
+ * the iteration count and reports the median of several samples.
+*******************************************************************************/
+
+/**
+ * BenchFunc - Run the benchmarked operation `iterations` times.
+ */
+typedef void (*BenchFunc)(void *state, unsigned long iterations);
+
+/**
+ * Parse the harness options:
+ *   --cpu N        pin to given core (default 0, -1 disables pinning)
+ *   --json FILE    write the results as JSON to FILE ("-" for stdout)
+ *   --filter STR   only run benchmarks whose name contains STR
+ *   --quick        shorter warmup and fewer samples
+ *
+ * Returns 1 on success, 0 on invalid arguments.
+ */
+int
+bench_init(int argc, char *argv[]);
+
+/**
+ * Measure a benchmark processing `items` items per iteration.
+ *
+ * Times are reported per item, so batched and single-call variants of the
+ * same operation are directly comparable.
+ */
+void
+bench_run(const char *name, unsigned items, BenchFunc fn, void *state);
+
+/**
+ * Write the results and release the harness. Returns the process exit code.
+ */
+int
+bench_finish(void);
+
+/*******************************************************************************
+ * Benchmark suites.
+*******************************************************************************/
+
+void
+bench_matlib(void);
+
+/**
+ * Clustered light binning, run on the worker threads started by job_init().
+ */
+void
+bench_cluster(void);
+
+/**
+ * Spatial hash grid rebuilds and queries over 1M points.
+ */
+void
+bench_spatial(void);
@@ -0,0 +1,66 @@
+#include "bench.h"
+#include "cluster.h"
+#include "mem.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define LIGHTS 4096
+
+static struct {
+	ClusterGrid grid;
+	Light lights[LIGHTS];
+	Mat view;
+	unsigned count;
+} d;
+
+static float
+frand(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static void
+setup(void)
+{
+	Mat proj;
+	mat_persp(&proj, 60.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+	cluster_init(&d.grid, &proj, 0.1f, 500.0f);
+
+	// lights spread uniformly over the volume of the frustum of a camera at
+	// the origin looking down -z
+	srand(1);
+	for (unsigned i = 0; i < LIGHTS; i++) {
+		Light *l = &d.lights[i];
+		float z = 300.0f * cbrtf(frand(0.0f, 1.0f));
+		l->pos[0] = frand(-z, z);
+		l->pos[1] = frand(-z, z) * 0.6f;
+		l->pos[2] = -z;
+		l->radius = frand(1.0f, 8.0f);
+		l->color[0] = l->color[1] = l->color[2] = 1.0f;
+		l->type = LIGHT_POINT;
+	}
+	mat_ident(&d.view);
+}
+
+static void
+bin(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		cluster_bin(&d.grid, &d.view, d.lights, d.count);
+		// the index list lives in the frame arena
+		mem_frame_end();
+	}
+}
+
+void
+bench_cluster(void)
+{
+	setup();
+
+	d.count = 1024;
+	bench_run("cluster_bin/1024", 1, bin, NULL);
+	d.count = LIGHTS;
+	bench_run("cluster_bin/4096", 1, bin, NULL);
+
+	cluster_free(&d.grid);
+}
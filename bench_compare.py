@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Compare benchmark results against a baseline and flag regressions.
+
+Usage: bench_compare.py BASELINE CURRENT [CURRENT...] [--threshold PERCENT]
+       bench_compare.py --merge OUT RUN [RUN...]
+
+All files are JSON reports written by `matbench --json`. When several
+current reports are given, for instance from repeated runs, each benchmark
+is taken from the run with the lowest ns/op; --merge writes the reports of
+repeated runs merged that way to OUT, to be used as a baseline or current
+report.
+
+A benchmark regresses when its ns/op grows by more than its tolerance: the
+largest of the threshold (5% by default), the spread of the baseline and the
+spread of the current result, spread being the range of the samples of a run
+relative to their median. Changes within the noise of either run are not
+reported. Exits with status 1 when any benchmark regressed.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        report = json.load(f)
+    return {b['name']: b for b in report['benchmarks']}
+
+
+def load_best(paths):
+    """Merge reports, keeping the fastest run of every benchmark."""
+    best = {}
+    for path in paths:
+        for name, b in load(path).items():
+            if name not in best or b['ns_per_op'] < best[name]['ns_per_op']:
+                best[name] = b
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('reports', nargs='+', metavar='REPORT')
+    parser.add_argument('--threshold', type=float, default=5.0,
+                        help='allowed slowdown in percent (default: 5)')
+    parser.add_argument('--merge', metavar='OUT',
+                        help='write the fastest run of every benchmark to OUT')
+    args = parser.parse_args()
+
+    if args.merge:
+        best = load_best(args.reports)
+        with open(args.reports[0]) as f:
+            context = json.load(f).get('context', {})
+        with open(args.merge, 'w') as f:
+            json.dump({'context': context, 'benchmarks': list(best.values())}, f, indent=2)
+            f.write('\n')
+        return 0
+    if len(args.reports) < 2:
+        parser.error('a baseline and at least one current report are needed')
+
+    baseline = load(args.reports[0])
+    current = load_best(args.reports[1:])
+
+    regressions = 0
+    print('%-32s %10s %10s %9s %9s' % ('benchmark', 'base ns', 'curr ns', 'change', 'allowed'))
+    for name, cur in current.items():
+        base = baseline.get(name)
+        if base is None:
+            print('%-32s %10s %10.2f %9s' % (name, '-', cur['ns_per_op'], 'new'))
+            continue
+
+        change = (cur['ns_per_op'] / base['ns_per_op'] - 1) * 100
+        allowed = max(args.threshold,
+                      base.get('spread', 0) * 100,
+                      cur.get('spread', 0) * 100)
+        mark = ''
+        if change > allowed:
+            mark = '  REGRESSION'
+            regressions += 1
+        elif change < -allowed:
+            mark = '  improved'
+        print('%-32s %10.2f %10.2f %+8.1f%% %8.1f%%%s' % (
+            name, base['ns_per_op'], cur['ns_per_op'], change, allowed, mark))
+
+    for name in baseline:
+        if name not in current:
+            print('%-32s %10.2f %10s %9s' % (name, baseline[name]['ns_per_op'], '-', 'missing'))
+
+    if regressions:
+        print('\n%d benchmark(s) regressed by more than their tolerance' % regressions)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,31 @@
+#include "bench.h"
+#include "job.h"
+#include "mem.h"
+#include <stdlib.h>
+
+#define BENCH_FRAME_ARENA_SIZE (4 << 20)
+
+int
+main(int argc, char *argv[])
+{
+	// start the workers before bench_init() pins the main thread, so that
+	// they keep the default affinity
+	if (!mem_init(BENCH_FRAME_ARENA_SIZE) || !job_init(0)) {
+		mem_shutdown();
+		return EXIT_FAILURE;
+	}
+	if (!bench_init(argc, argv)) {
+		job_shutdown();
+		mem_shutdown();
+		return EXIT_FAILURE;
+	}
+
+	bench_matlib();
+	bench_cluster();
+	bench_spatial();
+
+	int status = bench_finish();
+	job_shutdown();
+	mem_shutdown();
+	return status;
+}
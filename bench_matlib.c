@@ -0,0 +1,273 @@
+#include "bench.h"
+#include "camera.h"
+#include "fmath.h"
+#include <stddef.h>
+
+#define BATCH 1024
+
+static struct {
+	Mat m[BATCH], m2[BATCH], mr[BATCH];
+	Vec v[BATCH], v2[BATCH], vr[BATCH];
+	Qtr q[BATCH], q2[BATCH], qr[BATCH];
+	float f[BATCH], f2[BATCH], fr[BATCH], fr2[BATCH];
+	DMat dm[BATCH], dm2[BATCH], dmr[BATCH];
+	DVec dv[BATCH];
+	DQtr dq[BATCH];
+	Camera cam;
+	Mat view;
+} d;
+
+/*
+ * Define a single-call and a batched benchmark of an expression operating on
+ * the element `i` of the data arrays.
+ */
+#define BENCH_OP(name, expr)                                                   \
+	static void                                                            \
+	name##_single(void *state, unsigned long n)                            \
+	{                                                                      \
+		for (unsigned long k = 0; k < n; k++) {                        \
+			const unsigned i = k & 7;                              \
+			expr;                                                  \
+		}                                                              \
+	}                                                                      \
+	static void                                                            \
+	name##_batch(void *state, unsigned long n)                             \
+	{                                                                      \
+		for (unsigned long k = 0; k < n; k++) {                        \
+			for (unsigned i = 0; i < BATCH; i++) {                 \
+				expr;                                          \
+			}                                                      \
+		}                                                              \
+	}
+
+#define BENCH_REGISTER(name)                                                   \
+	bench_run(#name, 1, name##_single, NULL);                              \
+	bench_run(#name "/batch", BATCH, name##_batch, NULL)
+
+BENCH_OP(mat_mul, mat_mul(&d.m[i], &d.m2[i], &d.mr[i]))
+BENCH_OP(mat_imul, mat_imul(&d.mr[i], &d.m2[i]))
+BENCH_OP(mat_mulv, mat_mulv(&d.m[i], &d.v[i], &d.vr[i]))
+BENCH_OP(mat_rotate, mat_rotate(&d.mr[i], 0, 1, 0, d.f[i]))
+BENCH_OP(mat_rotatev, mat_rotatev(&d.mr[i], &d.v2[i], d.f[i]))
+BENCH_OP(mat_rotateq, mat_rotateq(&d.mr[i], &d.q[i]))
+BENCH_OP(mat_get_rotation, d.qr[i] = mat_get_rotation(&d.m[i]))
+BENCH_OP(mat_scale, mat_scale(&d.mr[i], 1, 1, 1))
+BENCH_OP(mat_scalev, mat_scalev(&d.mr[i], &d.v2[i]))
+BENCH_OP(mat_get_scale, d.vr[i] = mat_get_scale(&d.m[i]))
+BENCH_OP(mat_translate, mat_translate(&d.mr[i], 0, 0, 0))
+BENCH_OP(mat_translatev, mat_translatev(&d.mr[i], &d.v[i]))
+BENCH_OP(mat_get_translation, d.vr[i] = mat_get_translation(&d.m[i]))
+BENCH_OP(mat_lookat, mat_lookat(&d.mr[i], 1, 2, 3, 0, 0, 0, 0, 1, 0))
+BENCH_OP(mat_lookatv, mat_lookatv(&d.mr[i], &d.v[i], &d.v2[i], &d.v2[0]))
+BENCH_OP(mat_ortho, mat_ortho(&d.mr[i], -1, 1, 1, -1, 0.1f, 100))
+BENCH_OP(mat_persp, mat_persp(&d.mr[i], 60, 1.333f, 0.1f, 100))
+BENCH_OP(mat_ident, mat_ident(&d.mr[i]))
+BENCH_OP(mat_compose, mat_compose(&d.mr[i], &d.v[i], &d.q[i], &d.v2[i]))
+BENCH_OP(mat_inverse, mat_inverse(&d.m[i], &d.mr[i]))
+BENCH_OP(mat_transpose, mat_transpose(&d.m[i], &d.mr[i]))
+
+BENCH_OP(vec, d.vr[i] = vec(d.f[i], 0, 0, 1))
+BENCH_OP(vec_mulf, vec_mulf(&d.v[i], d.f[i], &d.vr[i]))
+BENCH_OP(vec_imulf, vec_imulf(&d.vr[i], 1.0f))
+BENCH_OP(vec_add, vec_add(&d.v[i], &d.v2[i], &d.vr[i]))
+BENCH_OP(vec_iadd, vec_iadd(&d.vr[i], &d.v2[i]))
+BENCH_OP(vec_addf, vec_addf(&d.v[i], d.f[i], &d.vr[i]))
+BENCH_OP(vec_iaddf, vec_iaddf(&d.vr[i], 0.0f))
+BENCH_OP(vec_sub, vec_sub(&d.v[i], &d.v2[i], &d.vr[i]))
+BENCH_OP(vec_isub, vec_isub(&d.vr[i], &d.v2[i]))
+BENCH_OP(vec_subf, vec_subf(&d.v[i], d.f[i], &d.vr[i]))
+BENCH_OP(vec_isubf, vec_isubf(&d.vr[i], 0.0f))
+BENCH_OP(vec_dot, d.fr[i] = vec_dot(&d.v[i], &d.v2[i]))
+BENCH_OP(vec_mag, d.fr[i] = vec_mag(&d.v[i]))
+BENCH_OP(vec_cross, vec_cross(&d.v[i], &d.v2[i], &d.vr[i]))
+BENCH_OP(vec_norm, vec_norm(&d.v2[i]))
+BENCH_OP(vec_clamp, vec_clamp(&d.v2[i], 2.0f))
+BENCH_OP(vec_lerp, vec_lerp(&d.v[i], &d.v2[i], 0.5f, &d.vr[i]))
+
+BENCH_OP(qtr, d.qr[i] = qtr(1, 0, 0, d.f[i]))
+BENCH_OP(qtr_rotate, qtr_rotate(&d.qr[i], 0, 1, 0, d.f[i]))
+BENCH_OP(qtr_rotatev, qtr_rotatev(&d.qr[i], &d.v2[i], d.f[i]))
+BENCH_OP(qtr_add, qtr_add(&d.q[i], &d.q2[i], &d.qr[i]))
+BENCH_OP(qtr_iadd, qtr_iadd(&d.qr[i], &d.q2[i]))
+BENCH_OP(qtr_mul, qtr_mul(&d.q[i], &d.q2[i], &d.qr[i]))
+BENCH_OP(qtr_imul, qtr_imul(&d.qr[i], &d.q2[i]))
+BENCH_OP(qtr_mulf, qtr_mulf(&d.q[i], d.f[i], &d.qr[i]))
+BENCH_OP(qtr_imulf, qtr_imulf(&d.qr[i], 1.0f))
+BENCH_OP(qtr_dot, d.fr[i] = qtr_dot(&d.q[i], &d.q2[i]))
+BENCH_OP(qtr_norm, qtr_norm(&d.q2[i]))
+BENCH_OP(qtr_lerp, qtr_lerp(&d.q[i], &d.q2[i], 0.5f, &d.qr[i]))
+
+BENCH_OP(dmat_mul, dmat_mul(&d.dm[i], &d.dm2[i], &d.dmr[i]))
+BENCH_OP(dmat_compose, dmat_compose(&d.dmr[i], &d.dv[i], &d.dq[i], &d.dv[0]))
+BENCH_OP(dmat_relative, dmat_relative(&d.dm[i], &d.cam.eye, &d.mr[i]))
+
+BENCH_OP(fm_sincos, fm_sincos(d.f[i], &d.fr[i], &d.fr2[i]))
+BENCH_OP(fm_acos, d.fr[i] = fm_acos(d.f2[i]))
+BENCH_OP(fm_atan2, d.fr[i] = fm_atan2(d.f[i], d.f2[i]))
+BENCH_OP(fm_rsqrt, d.fr[i] = fm_rsqrt(d.f[i]))
+
+/*
+ * Transform update of a world made of objects far from the origin, composed
+ * in single precision versus double precision followed by the
+ * camera-relative conversion.
+ */
+BENCH_OP(transform_update_float, {
+	mat_compose(&d.m2[i], &d.v[i], &d.q[i], &d.v2[0]);
+	mat_mul(&d.view, &d.m2[i], &d.mr[i]);
+})
+BENCH_OP(transform_update_double, {
+	dmat_compose(&d.dmr[i], &d.dv[i], &d.dq[i], &d.dv[0]);
+	camera_model_view(&d.cam, &d.view, &d.dmr[i], &d.mr[i]);
+})
+
+/*
+ * Stream functions, timed per element.
+ */
+static void
+fm_sincos_v_batch(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		fm_sincos_v(d.f, d.fr, d.fr2, BATCH);
+	}
+}
+
+static void
+fm_acos_v_batch(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		fm_acos_v(d.f2, d.fr, BATCH);
+	}
+}
+
+static void
+fm_atan2_v_batch(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		fm_atan2_v(d.f, d.f2, d.fr, BATCH);
+	}
+}
+
+static void
+fm_rsqrt_v_batch(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		fm_rsqrt_v(d.f, d.fr, BATCH);
+	}
+}
+
+static void
+setup(void)
+{
+	for (unsigned i = 0; i < BATCH; i++) {
+		float a = 0.001f * i;
+
+		// orthonormal matrices and unit quaternions, so that the in-place
+		// operations stay numerically stable however many times they run
+		mat_ident(&d.m[i]);
+		mat_rotate(&d.m[i], 0, 0, 1, a);
+		mat_ident(&d.m2[i]);
+		mat_rotate(&d.m2[i], 1, 0, 0, -a);
+		mat_ident(&d.mr[i]);
+
+		d.v[i] = vec(1 + a, 2, 3, 1);
+		d.v2[i] = vec(0, 1, 0, 0);
+		d.vr[i] = vec(0, 0, 0, 0);
+
+		d.q[i] = qtr(1, 0, 0, 0);
+		qtr_rotate(&d.q[i], 0, 1, 0, a);
+		d.q2[i] = qtr(1, 0, 0, 0);
+		qtr_rotate(&d.q2[i], 1, 0, 0, a);
+		d.qr[i] = qtr(1, 0, 0, 0);
+
+		d.f[i] = a + 0.5f;
+		d.f2[i] = a - 0.5f;
+
+		dmat_ident(&d.dm[i]);
+		dmat_translate(&d.dm[i], 1e6 + i, 0, 1e6);
+		dmat_ident(&d.dm2[i]);
+		d.dv[i] = dvec(1e6 + i, 0, 1e6 + i, 1);
+		d.dq[i] = dqtr(1, 0, 0, 0);
+		dqtr_rotate(&d.dq[i], 0, 1, 0, a);
+	}
+	d.dv[0] = dvec(1, 1, 1, 0);
+
+	d.cam.eye = dvec(1e6, 10, 1e6, 1);
+	d.cam.target = dvec(1e6 + 100, 0, 1e6 + 100, 1);
+	d.cam.up = dvec(0, 1, 0, 0);
+	camera_view(&d.cam, &d.view);
+}
+
+void
+bench_matlib(void)
+{
+	setup();
+
+	BENCH_REGISTER(mat_mul);
+	BENCH_REGISTER(mat_imul);
+	BENCH_REGISTER(mat_mulv);
+	BENCH_REGISTER(mat_rotate);
+	BENCH_REGISTER(mat_rotatev);
+	BENCH_REGISTER(mat_rotateq);
+	BENCH_REGISTER(mat_get_rotation);
+	BENCH_REGISTER(mat_scale);
+	BENCH_REGISTER(mat_scalev);
+	BENCH_REGISTER(mat_get_scale);
+	BENCH_REGISTER(mat_translate);
+	BENCH_REGISTER(mat_translatev);
+	BENCH_REGISTER(mat_get_translation);
+	BENCH_REGISTER(mat_lookat);
+	BENCH_REGISTER(mat_lookatv);
+	BENCH_REGISTER(mat_ortho);
+	BENCH_REGISTER(mat_persp);
+	BENCH_REGISTER(mat_ident);
+	BENCH_REGISTER(mat_compose);
+	BENCH_REGISTER(mat_inverse);
+	BENCH_REGISTER(mat_transpose);
+
+	BENCH_REGISTER(vec);
+	BENCH_REGISTER(vec_mulf);
+	BENCH_REGISTER(vec_imulf);
+	BENCH_REGISTER(vec_add);
+	BENCH_REGISTER(vec_iadd);
+	BENCH_REGISTER(vec_addf);
+	BENCH_REGISTER(vec_iaddf);
+	BENCH_REGISTER(vec_sub);
+	BENCH_REGISTER(vec_isub);
+	BENCH_REGISTER(vec_subf);
+	BENCH_REGISTER(vec_isubf);
+	BENCH_REGISTER(vec_dot);
+	BENCH_REGISTER(vec_mag);
+	BENCH_REGISTER(vec_cross);
+	BENCH_REGISTER(vec_norm);
+	BENCH_REGISTER(vec_clamp);
+	BENCH_REGISTER(vec_lerp);
+
+	BENCH_REGISTER(qtr);
+	BENCH_REGISTER(qtr_rotate);
+	BENCH_REGISTER(qtr_rotatev);
+	BENCH_REGISTER(qtr_add);
+	BENCH_REGISTER(qtr_iadd);
+	BENCH_REGISTER(qtr_mul);
+	BENCH_REGISTER(qtr_imul);
+	BENCH_REGISTER(qtr_mulf);
+	BENCH_REGISTER(qtr_imulf);
+	BENCH_REGISTER(qtr_dot);
+	BENCH_REGISTER(qtr_norm);
+	BENCH_REGISTER(qtr_lerp);
+
+	BENCH_REGISTER(dmat_mul);
+	BENCH_REGISTER(dmat_compose);
+	BENCH_REGISTER(dmat_relative);
+
+	BENCH_REGISTER(fm_sincos);
+	BENCH_REGISTER(fm_acos);
+	BENCH_REGISTER(fm_atan2);
+	BENCH_REGISTER(fm_rsqrt);
+	bench_run("fm_sincos_v/batch", BATCH, fm_sincos_v_batch, NULL);
+	bench_run("fm_acos_v/batch", BATCH, fm_acos_v_batch, NULL);
+	bench_run("fm_atan2_v/batch", BATCH, fm_atan2_v_batch, NULL);
+	bench_run("fm_rsqrt_v/batch", BATCH, fm_rsqrt_v_batch, NULL);
+
+	BENCH_REGISTER(transform_update_float);
+	BENCH_REGISTER(transform_update_double);
+}
@@ -0,0 +1,115 @@
+#include "bench.h"
+#include "spatial.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POINTS (1 << 20)
+#define QUERIES 1024
+#define MAX_RESULTS 256
+
+static struct {
+	SpatialGrid grid;
+	Vec *pos;
+	Vec *vel;
+	Vec queries[QUERIES];
+	uint32_t ids[MAX_RESULTS];
+	float dist2[MAX_RESULTS];
+	SpatialPair *pairs;
+} d;
+
+static float
+frand(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static int
+setup(void)
+{
+	d.pos = malloc(POINTS * sizeof(Vec));
+	d.vel = malloc(POINTS * sizeof(Vec));
+	d.pairs = malloc(POINTS * sizeof(SpatialPair));
+	if (!d.pos || !d.vel || !d.pairs || !spatial_init(&d.grid, 1.0f)) {
+		return 0;
+	}
+
+	// about one point per cell
+	srand(1);
+	for (unsigned i = 0; i < POINTS; i++) {
+		d.pos[i] = vec(frand(-50, 50), frand(-50, 50), frand(-50, 50), 1);
+		d.vel[i] = vec(frand(-1, 1), frand(-1, 1), frand(-1, 1), 0);
+	}
+	for (unsigned i = 0; i < QUERIES; i++) {
+		d.queries[i] = vec(frand(-50, 50), frand(-50, 50), frand(-50, 50), 1);
+	}
+
+	return spatial_build(&d.grid, d.pos, POINTS);
+}
+
+static void
+build(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		spatial_build(&d.grid, d.pos, POINTS);
+	}
+}
+
+static void
+move_build(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		for (unsigned i = 0; i < POINTS; i++) {
+			Vec step;
+			vec_mulf(&d.vel[i], 1.0f / 60.0f, &step);
+			vec_iadd(&d.pos[i], &step);
+		}
+		spatial_build(&d.grid, d.pos, POINTS);
+	}
+}
+
+static void
+range(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		for (unsigned i = 0; i < QUERIES; i++) {
+			spatial_range(&d.grid, &d.queries[i], 2.0f, d.ids, MAX_RESULTS);
+		}
+	}
+}
+
+static void
+nearest(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		for (unsigned i = 0; i < QUERIES; i++) {
+			spatial_nearest(&d.grid, &d.queries[i], 8, d.ids, d.dist2);
+		}
+	}
+}
+
+static void
+pairs(void *state, unsigned long n)
+{
+	for (unsigned long k = 0; k < n; k++) {
+		spatial_pairs(&d.grid, 0.5f, d.pairs, POINTS);
+	}
+}
+
+void
+bench_spatial(void)
+{
+	if (!setup()) {
+		fprintf(stderr, "bench_spatial: out of memory\n");
+	} else {
+		bench_run("spatial_build/1M", POINTS, build, NULL);
+		bench_run("spatial_move_build/1M", POINTS, move_build, NULL);
+		bench_run("spatial_range/r2", QUERIES, range, NULL);
+		bench_run("spatial_nearest/k8", QUERIES, nearest, NULL);
+		bench_run("spatial_pairs/1M", POINTS, pairs, NULL);
+	}
+
+	spatial_free(&d.grid);
+	free(d.pos);
+	free(d.vel);
+	free(d.pairs);
+}
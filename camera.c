@@ -0,0 +1,34 @@
+#include "camera.h"
+
+void
+camera_view(const Camera *cam, Mat *r_view)
+{
+	DVec origin = dvec(0, 0, 0, 0), dir;
+	dvec_sub(&cam->target, &cam->eye, &dir);
+	dir.data[3] = 0;
+
+	DMat view;
+	dmat_lookatv(&view, &origin, &dir, &cam->up);
+	dmat_to_mat(&view, r_view);
+}
+
+void
+camera_model_view(const Camera *cam, const Mat *view, const DMat *world, Mat *r_mv)
+{
+	Mat rel;
+	dmat_relative(world, &cam->eye, &rel);
+	mat_mul(view, &rel, r_mv);
+}
+
+void
+camera_model_view_batch(
+	const Camera *cam,
+	const Mat *view,
+	const DMat *world,
+	Mat *r_mv,
+	unsigned count
+) {
+	for (unsigned i = 0; i < count; i++) {
+		camera_model_view(cam, view, &world[i], &r_mv[i]);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "matlib.h"
+
+/**
+ * Camera - Viewpoint placed in double-precision world coordinates.
+ *
+ * Rendering is camera-relative: object transforms are composed in double
+ * precision and only their offset from the camera is converted to single
+ * precision, so that geometry far from the world origin does not jitter.
+ */
+typedef struct Camera {
+	DVec eye;
+	DVec target;
+	DVec up;
+} Camera;
+
+/**
+ * Compute the view matrix of the camera moved to the origin, which only
+ * contains its orientation.
+ */
+void
+camera_view(const Camera *cam, Mat *r_view);
+
+/**
+ * Compute the single-precision model-view matrix of a world transform.
+ */
+void
+camera_model_view(const Camera *cam, const Mat *view, const DMat *world, Mat *r_mv);
+
+void
+camera_model_view_batch(
+	const Camera *cam,
+	const Mat *view,
+	const DMat *world,
+	Mat *r_mv,
+	unsigned count
+);
@@ -0,0 +1,403 @@
+#include "cluster.h"
+#include "job.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+/*
+ * Screen-space tile range covered by a light within a depth slice.
+ */
+typedef struct ClusterRect {
+	uint16_t light;
+	uint8_t x0, x1, y0, y1;
+} ClusterRect;
+
+static void
+free_lights(ClusterGrid *grid)
+{
+	free(grid->vx);
+	free(grid->vy);
+	free(grid->vd);
+	free(grid->vr);
+	for (unsigned s = 0; s < CLUSTER_Z; s++) {
+		free(grid->slice_lights[s]);
+		free(grid->slice_rects[s]);
+		grid->slice_lights[s] = NULL;
+		grid->slice_rects[s] = NULL;
+	}
+	grid->vx = grid->vy = grid->vd = grid->vr = NULL;
+	grid->light_capacity = 0;
+}
+
+static int
+reserve_lights(ClusterGrid *grid, unsigned count)
+{
+	if (count <= grid->light_capacity) {
+		return 1;
+	}
+
+	free_lights(grid);
+	grid->vx = malloc(count * sizeof(float));
+	grid->vy = malloc(count * sizeof(float));
+	grid->vd = malloc(count * sizeof(float));
+	grid->vr = malloc(count * sizeof(float));
+	int ok = grid->vx && grid->vy && grid->vd && grid->vr;
+	for (unsigned s = 0; ok && s < CLUSTER_Z; s++) {
+		grid->slice_lights[s] = malloc(count * sizeof(uint16_t));
+		grid->slice_rects[s] = malloc(count * sizeof(ClusterRect));
+		ok = grid->slice_lights[s] && grid->slice_rects[s];
+	}
+	if (!ok) {
+		free_lights(grid);
+		return 0;
+	}
+	grid->light_capacity = count;
+	return 1;
+}
+
+int
+cluster_init(ClusterGrid *grid, const Mat *proj, float near, float far)
+{
+	memset(grid, 0, sizeof(ClusterGrid));
+	if (near <= 0 || far <= near) {
+		fprintf(stderr, "invalid cluster depth range [%g, %g]\n", near, far);
+		return 0;
+	}
+	grid->scale_x = proj->data[0];
+	grid->scale_y = proj->data[5];
+	grid->near = near;
+	grid->far = far;
+	grid->log_ratio = logf(far / near);
+
+	for (unsigned s = 0; s <= CLUSTER_Z; s++) {
+		grid->slice_depth[s] = near * expf(grid->log_ratio * s / CLUSTER_Z);
+	}
+	grid->slice_depth[CLUSTER_Z] = far;
+
+	return 1;
+}
+
+void
+cluster_free(ClusterGrid *grid)
+{
+	free_lights(grid);
+	memset(grid, 0, sizeof(ClusterGrid));
+}
+
+unsigned
+cluster_slice(const ClusterGrid *grid, float depth)
+{
+	// binary search of the slice boundaries, cheaper than the logarithm
+	unsigned lo = 0, hi = CLUSTER_Z;
+	while (hi - lo > 1) {
+		unsigned mid = (lo + hi) / 2;
+		if (depth < grid->slice_depth[mid]) {
+			hi = mid;
+		} else {
+			lo = mid;
+		}
+	}
+	return lo;
+}
+
+#ifdef __SSE2__
+
+/*
+ * Compute the tile ranges of four lights in a slice, returning the mask of
+ * lights which touch it.
+ */
+static int
+slice_rects4(
+	const ClusterGrid *grid,
+	const uint16_t *lights,
+	__m128 zs0,
+	__m128 zs1,
+	__m128i *r_x0,
+	__m128i *r_x1,
+	__m128i *r_y0,
+	__m128i *r_y1
+) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	#define GATHER(a) _mm_set_ps(a[lights[3]], a[lights[2]], a[lights[1]], a[lights[0]])
+	__m128 vx = GATHER(grid->vx);
+	__m128 vy = GATHER(grid->vy);
+	__m128 d = GATHER(grid->vd);
+	__m128 r = GATHER(grid->vr);
+	#undef GATHER
+
+	// radius of the sphere cross-section closest to the eye within the slice
+	__m128 dz = _mm_sub_ps(d, _mm_min_ps(_mm_max_ps(d, zs0), zs1));
+	__m128 rs2 = _mm_sub_ps(_mm_mul_ps(r, r), _mm_mul_ps(dz, dz));
+	__m128 touch = _mm_cmpgt_ps(rs2, zero);
+	__m128 rs = _mm_sqrt_ps(_mm_max_ps(rs2, zero));
+
+	// depth range of the sphere within the slice
+	__m128 inv_min = _mm_div_ps(one, _mm_max_ps(_mm_sub_ps(d, r), zs0));
+	__m128 inv_max = _mm_div_ps(one, _mm_min_ps(_mm_add_ps(d, r), zs1));
+
+	// conservative projection of the cross-section bounds, dividing by the
+	// depth which pushes each bound furthest out
+	__m128 lo = _mm_sub_ps(vx, rs), hi = _mm_add_ps(vx, rs);
+	__m128 lo_neg = _mm_cmplt_ps(lo, zero), hi_pos = _mm_cmpgt_ps(hi, zero);
+	__m128 sx = _mm_set1_ps(grid->scale_x);
+	__m128 nx0 = _mm_mul_ps(sx, _mm_mul_ps(lo, _mm_or_ps(_mm_and_ps(lo_neg, inv_min), _mm_andnot_ps(lo_neg, inv_max))));
+	__m128 nx1 = _mm_mul_ps(sx, _mm_mul_ps(hi, _mm_or_ps(_mm_and_ps(hi_pos, inv_min), _mm_andnot_ps(hi_pos, inv_max))));
+
+	lo = _mm_sub_ps(vy, rs);
+	hi = _mm_add_ps(vy, rs);
+	lo_neg = _mm_cmplt_ps(lo, zero);
+	hi_pos = _mm_cmpgt_ps(hi, zero);
+	__m128 sy = _mm_set1_ps(grid->scale_y);
+	__m128 ny0 = _mm_mul_ps(sy, _mm_mul_ps(lo, _mm_or_ps(_mm_and_ps(lo_neg, inv_min), _mm_andnot_ps(lo_neg, inv_max))));
+	__m128 ny1 = _mm_mul_ps(sy, _mm_mul_ps(hi, _mm_or_ps(_mm_and_ps(hi_pos, inv_min), _mm_andnot_ps(hi_pos, inv_max))));
+
+	__m128 neg_one = _mm_set1_ps(-1.0f);
+	touch = _mm_and_ps(touch, _mm_cmplt_ps(nx0, one));
+	touch = _mm_and_ps(touch, _mm_cmpgt_ps(nx1, neg_one));
+	touch = _mm_and_ps(touch, _mm_cmplt_ps(ny0, one));
+	touch = _mm_and_ps(touch, _mm_cmpgt_ps(ny1, neg_one));
+
+	// NDC to tile coordinates
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 tiles_x = _mm_set1_ps(CLUSTER_X), max_x = _mm_set1_ps(CLUSTER_X - 1);
+	__m128 tiles_y = _mm_set1_ps(CLUSTER_Y), max_y = _mm_set1_ps(CLUSTER_Y - 1);
+	#define TILE(n, tiles, max) _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps( \
+		_mm_mul_ps(_mm_mul_ps(_mm_add_ps(n, one), half), tiles), zero), max))
+	*r_x0 = TILE(nx0, tiles_x, max_x);
+	*r_x1 = TILE(nx1, tiles_x, max_x);
+	*r_y0 = TILE(ny0, tiles_y, max_y);
+	*r_y1 = TILE(ny1, tiles_y, max_y);
+	#undef TILE
+
+	return _mm_movemask_ps(touch);
+}
+
+static unsigned
+collect_rects(const ClusterGrid *grid, unsigned s, ClusterRect *rects)
+{
+	const uint16_t *lights = grid->slice_lights[s];
+	unsigned light_count = grid->slice_light_count[s];
+	__m128 zs0 = _mm_set1_ps(grid->slice_depth[s]);
+	__m128 zs1 = _mm_set1_ps(grid->slice_depth[s + 1]);
+	unsigned count = 0;
+
+	for (unsigned i = 0; i < light_count; i += 4) {
+		// repeat the last light in the lanes past the end
+		uint16_t group[4];
+		for (unsigned k = 0; k < 4; k++) {
+			group[k] = lights[i + k < light_count ? i + k : light_count - 1];
+		}
+
+		__m128i x0, x1, y0, y1;
+		int mask = slice_rects4(grid, group, zs0, zs1, &x0, &x1, &y0, &y1);
+		if (light_count - i < 4) {
+			mask &= (1 << (light_count - i)) - 1;
+		}
+		if (!mask) {
+			continue;
+		}
+
+		int32_t ax0[4], ax1[4], ay0[4], ay1[4];
+		_mm_storeu_si128((__m128i*)ax0, x0);
+		_mm_storeu_si128((__m128i*)ax1, x1);
+		_mm_storeu_si128((__m128i*)ay0, y0);
+		_mm_storeu_si128((__m128i*)ay1, y1);
+		for (unsigned k = 0; k < 4; k++) {
+			if (mask & (1 << k)) {
+				ClusterRect *rect = &rects[count++];
+				rect->light = group[k];
+				rect->x0 = ax0[k];
+				rect->x1 = ax1[k];
+				rect->y0 = ay0[k];
+				rect->y1 = ay1[k];
+			}
+		}
+	}
+
+	return count;
+}
+
+#else
+
+static int
+project_range(float lo, float hi, float scale, float inv_min, float inv_max, unsigned tiles, uint8_t *r_t0, uint8_t *r_t1)
+{
+	float n0 = scale * lo * (lo < 0 ? inv_min : inv_max);
+	float n1 = scale * hi * (hi > 0 ? inv_min : inv_max);
+	if (n0 >= 1.0f || n1 <= -1.0f) {
+		return 0;
+	}
+	float t0 = (n0 + 1.0f) * 0.5f * tiles;
+	float t1 = (n1 + 1.0f) * 0.5f * tiles;
+	*r_t0 = t0 < 0 ? 0 : (t0 > tiles - 1 ? tiles - 1 : (unsigned)t0);
+	*r_t1 = t1 < 0 ? 0 : (t1 > tiles - 1 ? tiles - 1 : (unsigned)t1);
+	return 1;
+}
+
+static unsigned
+collect_rects(const ClusterGrid *grid, unsigned s, ClusterRect *rects)
+{
+	float zs0 = grid->slice_depth[s];
+	float zs1 = grid->slice_depth[s + 1];
+	unsigned count = 0;
+
+	for (unsigned l = 0; l < grid->slice_light_count[s]; l++) {
+		unsigned i = grid->slice_lights[s][l];
+		float d = grid->vd[i], r = grid->vr[i];
+		float dc = d < zs0 ? zs0 : (d > zs1 ? zs1 : d);
+		float rs2 = r * r - (d - dc) * (d - dc);
+		if (rs2 <= 0) {
+			continue;
+		}
+		float rs = sqrtf(rs2);
+		float inv_min = 1.0f / (d - r > zs0 ? d - r : zs0);
+		float inv_max = 1.0f / (d + r < zs1 ? d + r : zs1);
+
+		ClusterRect *rect = &rects[count];
+		if (project_range(grid->vx[i] - rs, grid->vx[i] + rs, grid->scale_x, inv_min, inv_max, CLUSTER_X, &rect->x0, &rect->x1) &&
+		    project_range(grid->vy[i] - rs, grid->vy[i] + rs, grid->scale_y, inv_min, inv_max, CLUSTER_Y, &rect->y0, &rect->y1)) {
+			rect->light = i;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+#endif
+
+/*
+ * Count the lights of every cluster of a slice, with offsets relative to the
+ * start of the slice.
+ */
+static void
+count_slice(void *data, unsigned begin, unsigned end)
+{
+	ClusterGrid *grid = data;
+
+	for (unsigned s = begin; s < end; s++) {
+		ClusterRect *rects = grid->slice_rects[s];
+		unsigned rect_count = collect_rects(grid, s, rects);
+		grid->slice_rect_count[s] = rect_count;
+
+		uint32_t *counts = grid->counts + cluster_index(0, 0, s);
+		uint32_t *offsets = grid->offsets + cluster_index(0, 0, s);
+
+		// count with a 2D difference array, in constant time per light
+		int32_t diff[CLUSTER_Y + 1][CLUSTER_X + 1];
+		memset(diff, 0, sizeof(diff));
+		for (unsigned r = 0; r < rect_count; r++) {
+			const ClusterRect *rect = &rects[r];
+			diff[rect->y0][rect->x0]++;
+			diff[rect->y0][rect->x1 + 1]--;
+			diff[rect->y1 + 1][rect->x0]--;
+			diff[rect->y1 + 1][rect->x1 + 1]++;
+		}
+
+		unsigned total = 0;
+		int32_t column[CLUSTER_X] = { 0 };
+		for (unsigned y = 0; y < CLUSTER_Y; y++) {
+			int32_t row = 0;
+			for (unsigned x = 0; x < CLUSTER_X; x++) {
+				row += diff[y][x];
+				column[x] += row;
+				unsigned c = y * CLUSTER_X + x;
+				offsets[c] = total;
+				counts[c] = column[x];
+				total += column[x];
+			}
+		}
+		grid->slice_total[s] = total;
+	}
+}
+
+/*
+ * Fill the part of the index list belonging to a slice, in light order.
+ */
+static void
+fill_slice(void *data, unsigned begin, unsigned end)
+{
+	ClusterGrid *grid = data;
+
+	for (unsigned s = begin; s < end; s++) {
+		unsigned base = 0;
+		for (unsigned p = 0; p < s; p++) {
+			base += grid->slice_total[p];
+		}
+
+		uint32_t *offsets = grid->offsets + cluster_index(0, 0, s);
+		for (unsigned c = 0; c < CLUSTER_X * CLUSTER_Y; c++) {
+			offsets[c] += base;
+		}
+
+		const ClusterRect *rects = grid->slice_rects[s];
+		uint32_t cursor[CLUSTER_X * CLUSTER_Y];
+		memcpy(cursor, offsets, sizeof(cursor));
+		for (unsigned r = 0; r < grid->slice_rect_count[s]; r++) {
+			const ClusterRect *rect = &rects[r];
+			const uint16_t light = rect->light;
+			for (unsigned y = rect->y0; y <= rect->y1; y++) {
+				uint32_t *row = cursor + y * CLUSTER_X;
+				for (unsigned x = rect->x0; x <= rect->x1; x++) {
+					grid->indices[row[x]++] = light;
+				}
+			}
+		}
+	}
+}
+
+int
+cluster_bin(ClusterGrid *grid, const Mat *view, const Light *lights, unsigned count)
+{
+	if (count > CLUSTER_MAX_LIGHTS || !reserve_lights(grid, count)) {
+		return 0;
+	}
+
+	// transform the light bounds to view space and distribute the lights to
+	// the depth slices they overlap
+	const float *v = view->data;
+	memset(grid->slice_light_count, 0, sizeof(grid->slice_light_count));
+	for (unsigned i = 0; i < count; i++) {
+		const float *p = lights[i].pos;
+		float d = -(v[8] * p[0] + v[9] * p[1] + v[10] * p[2] + v[11]);
+		float r = lights[i].radius;
+		grid->vx[i] = v[0] * p[0] + v[1] * p[1] + v[2] * p[2] + v[3];
+		grid->vy[i] = v[4] * p[0] + v[5] * p[1] + v[6] * p[2] + v[7];
+		grid->vd[i] = d;
+		grid->vr[i] = r;
+
+		if (d + r <= grid->near || d - r >= grid->far) {
+			continue;
+		}
+		unsigned z1 = cluster_slice(grid, d + r);
+		for (unsigned s = cluster_slice(grid, d - r); s <= z1; s++) {
+			grid->slice_lights[s][grid->slice_light_count[s]++] = i;
+		}
+	}
+	grid->light_count = count;
+
+	job_parallel_for(CLUSTER_Z, 1, count_slice, grid);
+
+	// the slices are filled in place once the size of the list is known
+	unsigned total = 0;
+	for (unsigned s = 0; s < CLUSTER_Z; s++) {
+		total += grid->slice_total[s];
+	}
+	grid->indices = arena_alloc(mem_frame(), total * sizeof(uint16_t), MEM_ALIGN_CACHE);
+	if (!grid->indices) {
+		memset(grid->counts, 0, sizeof(grid->counts));
+		grid->index_count = 0;
+		return 0;
+	}
+	grid->index_count = total;
+
+	job_parallel_for(CLUSTER_Z, 1, fill_slice, grid);
+
+	return 1;
+}
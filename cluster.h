@@ -0,0 +1,102 @@
+#pragma once
+
+#include "matlib.h"
+#include <stdint.h>
+
+/*******************************************************************************
+ * Clustered light binning.
+ *
+ * The view frustum is split into a grid of clusters: tiles in screen space
+ * and exponentially distributed slices in depth. Each frame the light bounding
+ * spheres are binned into the clusters they overlap, producing for every
+ * cluster an (offset, count) range into a compact light index list which the
+ * fragment shader walks.
+*******************************************************************************/
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_LIGHTS 65536
+
+typedef enum LightType {
+	LIGHT_POINT,
+	LIGHT_SPOT,
+} LightType;
+
+/**
+ * Light - Point or spot light, laid out as three vec4 for upload.
+ */
+typedef struct Light {
+	float pos[3];
+	float radius;
+	float color[3];
+	float type;
+	float dir[3];
+	float cos_cutoff;
+} Light;
+
+/**
+ * ClusterGrid - Cluster layout and light lists of a frame.
+ */
+typedef struct ClusterGrid {
+	// projection parameters
+	float scale_x, scale_y;
+	float near, far;
+	float log_ratio;
+
+	// per-cluster ranges into `indices`, which is allocated from the frame
+	// arena and stays valid until the end of the next frame
+	uint32_t offsets[CLUSTER_COUNT];
+	uint32_t counts[CLUSTER_COUNT];
+	uint16_t *indices;
+	unsigned index_count;
+
+	// view-space light bounds, in SoA layout
+	float *vx, *vy, *vd, *vr;
+	unsigned light_capacity;
+	unsigned light_count;
+
+	// depth slice boundaries and per-slice binning results
+	float slice_depth[CLUSTER_Z + 1];
+	uint16_t *slice_lights[CLUSTER_Z];
+	unsigned slice_light_count[CLUSTER_Z];
+	struct ClusterRect *slice_rects[CLUSTER_Z];
+	unsigned slice_rect_count[CLUSTER_Z];
+	unsigned slice_total[CLUSTER_Z];
+} ClusterGrid;
+
+/**
+ * Set up the grid for a perspective projection built with mat_persp().
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int
+cluster_init(ClusterGrid *grid, const Mat *proj, float near, float far);
+
+void
+cluster_free(ClusterGrid *grid);
+
+/**
+ * Cluster index of given coordinates.
+ */
+static inline unsigned
+cluster_index(unsigned x, unsigned y, unsigned z)
+{
+	return (z * CLUSTER_Y + y) * CLUSTER_X + x;
+}
+
+/**
+ * Depth slice of a view-space depth (positive distance from the eye).
+ */
+unsigned
+cluster_slice(const ClusterGrid *grid, float depth);
+
+/**
+ * Bin the lights into clusters, on the worker threads. The index list is
+ * allocated from mem_frame().
+ *
+ * Returns 1 on success, 0 if the frame arena has no room for the index list.
+ */
+int
+cluster_bin(ClusterGrid *grid, const Mat *view, const Light *lights, unsigned count);
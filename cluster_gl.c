@@ -0,0 +1,143 @@
+#include "cluster_gl.h"
+#include <string.h>
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+enum {
+	BUFFER_LIGHTS,
+	BUFFER_GRID,
+	BUFFER_INDICES,
+};
+
+const char *cluster_gl_fs =
+	"uniform samplerBuffer cluster_lights;\n"
+	"uniform usamplerBuffer cluster_grid;\n"
+	"uniform usamplerBuffer cluster_indices;\n"
+	"uniform float cluster_near;\n"
+	"uniform float cluster_log_ratio;\n"
+	"uniform vec2 cluster_viewport;\n"
+	"vec3 cluster_shade(vec3 pos, float depth, vec3 normal, vec3 albedo) {\n"
+	"	ivec3 tile = ivec3(\n"
+	"		gl_FragCoord.xy / cluster_viewport * vec2(" XSTR(CLUSTER_X) ", " XSTR(CLUSTER_Y) "),\n"
+	"		log(depth / cluster_near) / cluster_log_ratio * " XSTR(CLUSTER_Z) ".0\n"
+	"	);\n"
+	"	tile = clamp(tile, ivec3(0), ivec3(" XSTR(CLUSTER_X) " - 1, " XSTR(CLUSTER_Y) " - 1, " XSTR(CLUSTER_Z) " - 1));\n"
+	"	uvec2 range = texelFetch(cluster_grid,\n"
+	"		(tile.z * " XSTR(CLUSTER_Y) " + tile.y) * " XSTR(CLUSTER_X) " + tile.x).xy;\n"
+	"	vec3 color = vec3(0.0);\n"
+	"	for (uint i = range.x; i < range.x + range.y; i++) {\n"
+	"		int light = int(texelFetch(cluster_indices, int(i)).x) * 3;\n"
+	"		vec4 pos_radius = texelFetch(cluster_lights, light);\n"
+	"		vec4 color_type = texelFetch(cluster_lights, light + 1);\n"
+	"		vec4 dir_cutoff = texelFetch(cluster_lights, light + 2);\n"
+	"		vec3 to_light = pos_radius.xyz - pos;\n"
+	"		float dist = length(to_light);\n"
+	"		vec3 l = to_light / dist;\n"
+	"		float falloff = clamp(1.0 - dist / pos_radius.w, 0.0, 1.0);\n"
+	"		if (color_type.w > 0.5) {\n"
+	"			falloff *= step(dir_cutoff.w, dot(-l, dir_cutoff.xyz));\n"
+	"		}\n"
+	"		color += albedo * color_type.rgb * max(dot(normal, l), 0.0) * falloff * falloff;\n"
+	"	}\n"
+	"	return color;\n"
+	"}\n";
+
+int
+cluster_gl_init(ClusterBuffers *buf)
+{
+	static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+
+	memset(buf, 0, sizeof(ClusterBuffers));
+	glGenBuffers(3, buf->buffers);
+	glGenTextures(3, buf->textures);
+	for (unsigned i = 0; i < 3; i++) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buf->buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, buf->textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buf->buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void
+cluster_gl_free(ClusterBuffers *buf)
+{
+	glDeleteTextures(3, buf->textures);
+	glDeleteBuffers(3, buf->buffers);
+	memset(buf, 0, sizeof(ClusterBuffers));
+}
+
+static void
+upload(GLuint buffer, GLsizeiptr size, const void *data)
+{
+	// orphan the previous storage so that we don't wait for draws still
+	// reading from it
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+	if (size) {
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	}
+}
+
+void
+cluster_gl_upload(
+	ClusterBuffers *buf,
+	const ClusterGrid *grid,
+	const Light *lights,
+	unsigned count
+) {
+	upload(buf->buffers[BUFFER_LIGHTS], count * sizeof(Light), lights);
+
+	// interleave offsets and counts into RG texels
+	glBindBuffer(GL_TEXTURE_BUFFER, buf->buffers[BUFFER_GRID]);
+	glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+	uint32_t *dst = glMapBufferRange(
+		GL_TEXTURE_BUFFER,
+		0,
+		CLUSTER_COUNT * 2 * sizeof(uint32_t),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+	);
+	if (dst) {
+		for (unsigned c = 0; c < CLUSTER_COUNT; c++) {
+			dst[c * 2] = grid->offsets[c];
+			dst[c * 2 + 1] = grid->counts[c];
+		}
+		glUnmapBuffer(GL_TEXTURE_BUFFER);
+	}
+
+	upload(buf->buffers[BUFFER_INDICES], grid->index_count * sizeof(uint16_t), grid->indices);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	buf->light_count = count;
+}
+
+void
+cluster_gl_bind(const ClusterBuffers *buf)
+{
+	static const GLenum units[3] = {
+		CLUSTER_LIGHT_UNIT,
+		CLUSTER_GRID_UNIT,
+		CLUSTER_INDEX_UNIT,
+	};
+
+	for (unsigned i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, buf->textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void
+cluster_gl_uniforms(const ClusterGrid *grid, GLuint program, float width, float height)
+{
+	glUniform1i(glGetUniformLocation(program, "cluster_lights"), CLUSTER_LIGHT_UNIT);
+	glUniform1i(glGetUniformLocation(program, "cluster_grid"), CLUSTER_GRID_UNIT);
+	glUniform1i(glGetUniformLocation(program, "cluster_indices"), CLUSTER_INDEX_UNIT);
+	glUniform1f(glGetUniformLocation(program, "cluster_near"), grid->near);
+	glUniform1f(glGetUniformLocation(program, "cluster_log_ratio"), grid->log_ratio);
+	glUniform2f(glGetUniformLocation(program, "cluster_viewport"), width, height);
+}
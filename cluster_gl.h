@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cluster.h"
+#include <GL/glew.h>
+
+/**
+ * ClusterBuffers - Texture buffers holding the lights and cluster lists of a
+ * frame.
+ */
+typedef struct ClusterBuffers {
+	GLuint buffers[3];
+	GLuint textures[3];
+	unsigned light_count;
+} ClusterBuffers;
+
+/**
+ * GLSL snippet declaring the cluster lookup.
+ *
+ * Defines `vec3 cluster_shade(vec3 pos, float depth, vec3 normal, vec3 albedo)`
+ * which accumulates the lights of the fragment cluster; `pos` and `normal` are
+ * in world space like the lights, `depth` is the positive view-space depth.
+ * Fragment shaders include it after their #version line and set the uniforms
+ * with cluster_gl_uniforms().
+ */
+extern const char *cluster_gl_fs;
+
+#define CLUSTER_LIGHT_UNIT 4
+#define CLUSTER_GRID_UNIT 5
+#define CLUSTER_INDEX_UNIT 6
+
+/**
+ * Create the texture buffers. Returns 1 on success, 0 on failure.
+ */
+int
+cluster_gl_init(ClusterBuffers *buf);
+
+void
+cluster_gl_free(ClusterBuffers *buf);
+
+/**
+ * Upload the lights and the binning results of the frame, orphaning the
+ * storage of the previous one.
+ */
+void
+cluster_gl_upload(
+	ClusterBuffers *buf,
+	const ClusterGrid *grid,
+	const Light *lights,
+	unsigned count
+);
+
+/**
+ * Bind the texture buffers to their units.
+ */
+void
+cluster_gl_bind(const ClusterBuffers *buf);
+
+/**
+ * Set the lookup uniforms of `program`, which must be in use.
+ */
+void
+cluster_gl_uniforms(const ClusterGrid *grid, GLuint program, float width, float height);
@@ -0,0 +1,536 @@
+#include "cmdbuf.h"
+#include "job.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CAPACITY 4096
+#define FILE_MAGIC "CMDB"
+#define FILE_VERSION 1
+
+void
+cmd_init(CmdBuffer *buf)
+{
+	memset(buf, 0, sizeof(CmdBuffer));
+}
+
+void
+cmd_free(CmdBuffer *buf)
+{
+	free(buf->data);
+	memset(buf, 0, sizeof(CmdBuffer));
+}
+
+void
+cmd_reset(CmdBuffer *buf)
+{
+	buf->size = 0;
+	buf->count = 0;
+	buf->failed = 0;
+}
+
+/*
+ * Append a command, returning its payload or NULL if the buffer could not be
+ * grown.
+ */
+static void*
+push(CmdBuffer *buf, CmdType type, size_t payload_size)
+{
+	size_t size = (sizeof(CmdHeader) + payload_size + CMD_ALIGN - 1) & ~(size_t)(CMD_ALIGN - 1);
+	if (buf->size + size > buf->capacity) {
+		size_t capacity = buf->capacity ? buf->capacity : MIN_CAPACITY;
+		while (capacity < buf->size + size) {
+			capacity *= 2;
+		}
+		uint8_t *data = realloc(buf->data, capacity);
+		if (!data) {
+			buf->failed = 1;
+			return NULL;
+		}
+		buf->data = data;
+		buf->capacity = capacity;
+	}
+
+	CmdHeader *cmd = (CmdHeader*)(buf->data + buf->size);
+	cmd->type = type;
+	cmd->size = size;
+	buf->size += size;
+	buf->count++;
+	return cmd + 1;
+}
+
+void
+cmd_clear(CmdBuffer *buf, uint32_t flags, float r, float g, float b, float a, float depth)
+{
+	CmdClear *cmd = push(buf, CMD_CLEAR, sizeof(CmdClear));
+	if (cmd) {
+		cmd->flags = flags;
+		cmd->color[0] = r;
+		cmd->color[1] = g;
+		cmd->color[2] = b;
+		cmd->color[3] = a;
+		cmd->depth = depth;
+	}
+}
+
+void
+cmd_state(CmdBuffer *buf, uint32_t flags)
+{
+	CmdState *cmd = push(buf, CMD_STATE, sizeof(CmdState));
+	if (cmd) {
+		cmd->flags = flags;
+	}
+}
+
+void
+cmd_viewport(CmdBuffer *buf, int x, int y, unsigned width, unsigned height)
+{
+	CmdViewport *cmd = push(buf, CMD_VIEWPORT, sizeof(CmdViewport));
+	if (cmd) {
+		cmd->x = x;
+		cmd->y = y;
+		cmd->width = width;
+		cmd->height = height;
+	}
+}
+
+void
+cmd_program(CmdBuffer *buf, uint32_t program)
+{
+	CmdBind *cmd = push(buf, CMD_PROGRAM, sizeof(CmdBind));
+	if (cmd) {
+		cmd->handle = program;
+	}
+}
+
+void
+cmd_vertex_array(CmdBuffer *buf, uint32_t vao)
+{
+	CmdBind *cmd = push(buf, CMD_VERTEX_ARRAY, sizeof(CmdBind));
+	if (cmd) {
+		cmd->handle = vao;
+	}
+}
+
+void
+cmd_texture(CmdBuffer *buf, unsigned unit, CmdTextureType type, uint32_t texture)
+{
+	CmdTexture *cmd = push(buf, CMD_TEXTURE, sizeof(CmdTexture));
+	if (cmd) {
+		cmd->unit = unit;
+		cmd->type = type;
+		cmd->handle = texture;
+	}
+}
+
+void
+cmd_uniform_buffer(CmdBuffer *buf, unsigned index, uint32_t buffer, uint32_t offset, uint32_t size)
+{
+	CmdUniformBuffer *cmd = push(buf, CMD_UNIFORM_BUFFER, sizeof(CmdUniformBuffer));
+	if (cmd) {
+		cmd->index = index;
+		cmd->handle = buffer;
+		cmd->offset = offset;
+		cmd->size = size;
+	}
+}
+
+static void
+uniform(CmdBuffer *buf, CmdType type, int location, const void *values, size_t size, unsigned count)
+{
+	CmdUniform *cmd = push(buf, type, sizeof(CmdUniform) + size * count);
+	if (cmd) {
+		cmd->location = location;
+		cmd->count = count;
+		memcpy(cmd + 1, values, size * count);
+	}
+}
+
+void
+cmd_uniform_int(CmdBuffer *buf, int location, int32_t value)
+{
+	uniform(buf, CMD_UNIFORM_INT, location, &value, sizeof(int32_t), 1);
+}
+
+void
+cmd_uniform_float(CmdBuffer *buf, int location, float value)
+{
+	uniform(buf, CMD_UNIFORM_FLOAT, location, &value, sizeof(float), 1);
+}
+
+void
+cmd_uniform_vec4(CmdBuffer *buf, int location, const Vec *v, unsigned count)
+{
+	uniform(buf, CMD_UNIFORM_VEC4, location, v, sizeof(Vec), count);
+}
+
+void
+cmd_uniform_mat4(CmdBuffer *buf, int location, const Mat *m, unsigned count)
+{
+	uniform(buf, CMD_UNIFORM_MAT4, location, m, sizeof(Mat), count);
+}
+
+void
+cmd_draw(CmdBuffer *buf, CmdPrimitive primitive, unsigned first, unsigned count, unsigned instances)
+{
+	CmdDraw *cmd = push(buf, CMD_DRAW, sizeof(CmdDraw));
+	if (cmd) {
+		cmd->primitive = primitive;
+		cmd->first = first;
+		cmd->count = count;
+		cmd->instances = instances;
+	}
+}
+
+void
+cmd_draw_indexed(
+	CmdBuffer *buf,
+	CmdPrimitive primitive,
+	CmdIndexType index_type,
+	unsigned count,
+	unsigned offset,
+	int base_vertex,
+	unsigned instances
+) {
+	CmdDrawIndexed *cmd = push(buf, CMD_DRAW_INDEXED, sizeof(CmdDrawIndexed));
+	if (cmd) {
+		cmd->primitive = primitive;
+		cmd->index_type = index_type;
+		cmd->count = count;
+		cmd->offset = offset;
+		cmd->base_vertex = base_vertex;
+		cmd->instances = instances;
+	}
+}
+
+void
+cmd_call(CmdBuffer *buf, const CmdBuffer *callee)
+{
+	// a frame calling a buffer which failed recording fails as well
+	if (callee->failed) {
+		buf->failed = 1;
+		return;
+	}
+
+	CmdCall *cmd = push(buf, CMD_CALL, sizeof(CmdCall));
+	if (cmd) {
+		cmd->buffer = callee;
+	}
+}
+
+typedef struct RecordJob {
+	CmdBuffer *buffers;
+	CmdRecordFunc fn;
+	void *data;
+} RecordJob;
+
+static void
+record_buffers(void *data, unsigned begin, unsigned end)
+{
+	RecordJob *job = data;
+	for (unsigned i = begin; i < end; i++) {
+		cmd_reset(&job->buffers[i]);
+		job->fn(job->data, &job->buffers[i], i);
+	}
+}
+
+void
+cmd_record_parallel(CmdBuffer *buffers, unsigned count, CmdRecordFunc fn, void *data)
+{
+	RecordJob job = { buffers, fn, data };
+	job_parallel_for(count, 1, record_buffers, &job);
+}
+
+const CmdHeader*
+cmd_next(const CmdBuffer *buf, const CmdHeader *cursor)
+{
+	const uint8_t *next = cursor ? (const uint8_t*)cursor + cursor->size : buf->data;
+	return next < buf->data + buf->size ? (const CmdHeader*)next : NULL;
+}
+
+static const char *type_names[CMD_TYPE_COUNT] = {
+	[CMD_CLEAR] = "clear",
+	[CMD_STATE] = "state",
+	[CMD_VIEWPORT] = "viewport",
+	[CMD_PROGRAM] = "program",
+	[CMD_VERTEX_ARRAY] = "vertex_array",
+	[CMD_TEXTURE] = "texture",
+	[CMD_UNIFORM_BUFFER] = "uniform_buffer",
+	[CMD_UNIFORM_INT] = "uniform_int",
+	[CMD_UNIFORM_FLOAT] = "uniform_float",
+	[CMD_UNIFORM_VEC4] = "uniform_vec4",
+	[CMD_UNIFORM_MAT4] = "uniform_mat4",
+	[CMD_DRAW] = "draw",
+	[CMD_DRAW_INDEXED] = "draw_indexed",
+	[CMD_CALL] = "call",
+};
+
+const char*
+cmd_type_name(uint32_t type)
+{
+	return type < CMD_TYPE_COUNT && type_names[type] ? type_names[type] : "?";
+}
+
+static const char *primitive_names[] = {
+	"points",
+	"lines",
+	"triangles",
+	"triangle_strip",
+};
+
+static const char*
+primitive_name(uint32_t primitive)
+{
+	return primitive <= CMD_TRIANGLE_STRIP ? primitive_names[primitive] : "?";
+}
+
+static void
+trace(const CmdBuffer *buf, FILE *out, unsigned depth)
+{
+	for (const CmdHeader *cmd = cmd_next(buf, NULL); cmd; cmd = cmd_next(buf, cmd)) {
+		const void *p = cmd_payload(cmd);
+		fprintf(out, "%*s%s", depth * 2, "", type_names[cmd->type]);
+
+		switch (cmd->type) {
+		case CMD_CLEAR: {
+			const CmdClear *c = p;
+			fprintf(out, " flags %u color %g %g %g %g depth %g\n",
+				c->flags, c->color[0], c->color[1], c->color[2], c->color[3], c->depth);
+			break;
+		}
+		case CMD_STATE:
+			fprintf(out, " flags %u\n", ((const CmdState*)p)->flags);
+			break;
+		case CMD_VIEWPORT: {
+			const CmdViewport *c = p;
+			fprintf(out, " %d %d %u %u\n", c->x, c->y, c->width, c->height);
+			break;
+		}
+		case CMD_PROGRAM:
+		case CMD_VERTEX_ARRAY:
+			fprintf(out, " %u\n", ((const CmdBind*)p)->handle);
+			break;
+		case CMD_TEXTURE: {
+			const CmdTexture *c = p;
+			fprintf(out, " unit %u type %u %u\n", c->unit, c->type, c->handle);
+			break;
+		}
+		case CMD_UNIFORM_BUFFER: {
+			const CmdUniformBuffer *c = p;
+			fprintf(out, " index %u %u offset %u size %u\n", c->index, c->handle, c->offset, c->size);
+			break;
+		}
+		case CMD_UNIFORM_INT:
+		case CMD_UNIFORM_FLOAT:
+		case CMD_UNIFORM_VEC4:
+		case CMD_UNIFORM_MAT4: {
+			const CmdUniform *c = p;
+			unsigned n = c->count * (cmd->type == CMD_UNIFORM_MAT4 ? 16 : (cmd->type == CMD_UNIFORM_VEC4 ? 4 : 1));
+			fprintf(out, " location %d count %u", c->location, c->count);
+			for (unsigned i = 0; i < n; i++) {
+				if (cmd->type == CMD_UNIFORM_INT) {
+					fprintf(out, " %d", ((const int32_t*)(c + 1))[i]);
+				} else {
+					fprintf(out, " %g", ((const float*)(c + 1))[i]);
+				}
+			}
+			fputc('\n', out);
+			break;
+		}
+		case CMD_DRAW: {
+			const CmdDraw *c = p;
+			fprintf(out, " %s first %u count %u instances %u\n",
+				primitive_name(c->primitive), c->first, c->count, c->instances);
+			break;
+		}
+		case CMD_DRAW_INDEXED: {
+			const CmdDrawIndexed *c = p;
+			fprintf(out, " %s index_type %u count %u offset %u base_vertex %d instances %u\n",
+				primitive_name(c->primitive), c->index_type, c->count, c->offset, c->base_vertex, c->instances);
+			break;
+		}
+		case CMD_CALL:
+			fputc('\n', out);
+			trace(((const CmdCall*)p)->buffer, out, depth + 1);
+			break;
+		}
+	}
+}
+
+int
+cmd_write_trace(const CmdBuffer *buf, FILE *out)
+{
+	if (buf->failed) {
+		fprintf(stderr, "command buffer failed recording\n");
+		return 0;
+	}
+	trace(buf, out, 0);
+	return !ferror(out);
+}
+
+void
+cmd_stats(const CmdBuffer *buf, CmdStats *stats)
+{
+	for (const CmdHeader *cmd = cmd_next(buf, NULL); cmd; cmd = cmd_next(buf, cmd)) {
+		const void *p = cmd_payload(cmd);
+		stats->counts[cmd->type]++;
+		stats->bytes += cmd->size;
+
+		if (cmd->type == CMD_DRAW) {
+			const CmdDraw *c = p;
+			stats->draw_vertices += (unsigned long)c->count * c->instances;
+		} else if (cmd->type == CMD_DRAW_INDEXED) {
+			const CmdDrawIndexed *c = p;
+			stats->draw_vertices += (unsigned long)c->count * c->instances;
+		} else if (cmd->type == CMD_CALL) {
+			cmd_stats(((const CmdCall*)p)->buffer, stats);
+		}
+	}
+}
+
+static int
+save(const CmdBuffer *buf, FILE *out)
+{
+	for (const CmdHeader *cmd = cmd_next(buf, NULL); cmd; cmd = cmd_next(buf, cmd)) {
+		if (cmd->type == CMD_CALL) {
+			if (!save(((const CmdCall*)cmd_payload(cmd))->buffer, out)) {
+				return 0;
+			}
+		} else if (fwrite(cmd, cmd->size, 1, out) != 1) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int
+cmd_save(const CmdBuffer *buf, FILE *out)
+{
+	uint32_t version = FILE_VERSION;
+	if (buf->failed ||
+	    fwrite(FILE_MAGIC, 4, 1, out) != 1 ||
+	    fwrite(&version, sizeof(version), 1, out) != 1) {
+		return 0;
+	}
+	return save(buf, out);
+}
+
+/*
+ * Smallest payload of every command type, and value size of the uniforms.
+ */
+static const size_t payload_sizes[CMD_TYPE_COUNT] = {
+	[CMD_CLEAR] = sizeof(CmdClear),
+	[CMD_STATE] = sizeof(CmdState),
+	[CMD_VIEWPORT] = sizeof(CmdViewport),
+	[CMD_PROGRAM] = sizeof(CmdBind),
+	[CMD_VERTEX_ARRAY] = sizeof(CmdBind),
+	[CMD_TEXTURE] = sizeof(CmdTexture),
+	[CMD_UNIFORM_BUFFER] = sizeof(CmdUniformBuffer),
+	[CMD_UNIFORM_INT] = sizeof(CmdUniform),
+	[CMD_UNIFORM_FLOAT] = sizeof(CmdUniform),
+	[CMD_UNIFORM_VEC4] = sizeof(CmdUniform),
+	[CMD_UNIFORM_MAT4] = sizeof(CmdUniform),
+	[CMD_DRAW] = sizeof(CmdDraw),
+	[CMD_DRAW_INDEXED] = sizeof(CmdDrawIndexed),
+};
+
+static const size_t uniform_sizes[CMD_TYPE_COUNT] = {
+	[CMD_UNIFORM_INT] = sizeof(int32_t),
+	[CMD_UNIFORM_FLOAT] = sizeof(float),
+	[CMD_UNIFORM_VEC4] = sizeof(Vec),
+	[CMD_UNIFORM_MAT4] = sizeof(Mat),
+};
+
+/*
+ * Check that a loaded command holds everything replay and tracing read from
+ * it, and only values of the enumerations they index tables with.
+ */
+static int
+valid(const CmdHeader *cmd)
+{
+	const void *p = cmd_payload(cmd);
+	size_t size = cmd->size - sizeof(CmdHeader);
+	if (size < payload_sizes[cmd->type]) {
+		return 0;
+	}
+
+	switch (cmd->type) {
+	case CMD_TEXTURE:
+		return ((const CmdTexture*)p)->type <= CMD_TEXTURE_BUFFER;
+	case CMD_UNIFORM_INT:
+	case CMD_UNIFORM_FLOAT:
+	case CMD_UNIFORM_VEC4:
+	case CMD_UNIFORM_MAT4:
+		// divide rather than multiply, which could overflow
+		return ((const CmdUniform*)p)->count <= (size - sizeof(CmdUniform)) / uniform_sizes[cmd->type];
+	case CMD_DRAW:
+		return ((const CmdDraw*)p)->primitive <= CMD_TRIANGLE_STRIP;
+	case CMD_DRAW_INDEXED: {
+		const CmdDrawIndexed *c = p;
+		return c->primitive <= CMD_TRIANGLE_STRIP && c->index_type <= CMD_INDEX_U32;
+	}
+	default:
+		return 1;
+	}
+}
+
+int
+cmd_load(CmdBuffer *buf, FILE *in)
+{
+	char magic[4];
+	uint32_t version;
+	if (fread(magic, 4, 1, in) != 1 ||
+	    memcmp(magic, FILE_MAGIC, 4) != 0 ||
+	    fread(&version, sizeof(version), 1, in) != 1 ||
+	    version != FILE_VERSION) {
+		fprintf(stderr, "not a command buffer file\n");
+		return 0;
+	}
+
+	// commands are appended as they are read, drop them all on failure so
+	// that a partly loaded file is never replayed
+	size_t size = buf->size;
+	unsigned count = buf->count;
+	int failed = buf->failed;
+
+	int ok = 0;
+	for (;;) {
+		CmdHeader header;
+		size_t n = fread(&header, 1, sizeof(header), in);
+		if (n == 0 && feof(in)) {
+			ok = 1;
+			break;
+		}
+		if (n != sizeof(header)) {
+			fprintf(stderr, "truncated command buffer file\n");
+			break;
+		}
+
+		// calls can't be saved, their targets are inlined
+		if (header.type == 0 || header.type >= CMD_TYPE_COUNT || header.type == CMD_CALL ||
+		    header.size < sizeof(header) || header.size % CMD_ALIGN != 0 ||
+		    header.size > (1 << 20)) {
+			fprintf(stderr, "invalid command in command buffer file\n");
+			break;
+		}
+		void *payload = push(buf, header.type, header.size - sizeof(header));
+		if (!payload) {
+			fprintf(stderr, "out of memory loading command buffer file\n");
+			break;
+		}
+		if (fread(payload, header.size - sizeof(header), 1, in) != 1) {
+			fprintf(stderr, "truncated command buffer file\n");
+			break;
+		}
+		if (!valid((const CmdHeader*)payload - 1)) {
+			fprintf(stderr, "invalid %s command in command buffer file\n", type_names[header.type]);
+			break;
+		}
+	}
+
+	if (!ok) {
+		buf->size = size;
+		buf->count = count;
+		buf->failed = failed;
+	}
+	return ok;
+}
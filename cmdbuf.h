@@ -0,0 +1,304 @@
+#pragma once
+
+#include "matlib.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*******************************************************************************
+ * Recorded command buffers.
+ *
+ * Draw preparation records compact commands into buffers, on any thread and
+ * without touching the graphics API; the thread owning the context replays
+ * them afterwards. Commands are plain structs stored back to back, resources
+ * are opaque 32-bit handles and enumerations are backend-independent, so a
+ * buffer can equally be replayed through GL or written to a file.
+ *
+ * Buffers recorded once, for instance for static geometry, can be kept across
+ * frames and called from the per-frame buffers.
+*******************************************************************************/
+
+typedef enum CmdType {
+	CMD_CLEAR = 1,
+	CMD_STATE,
+	CMD_VIEWPORT,
+	CMD_PROGRAM,
+	CMD_VERTEX_ARRAY,
+	CMD_TEXTURE,
+	CMD_UNIFORM_BUFFER,
+	CMD_UNIFORM_INT,
+	CMD_UNIFORM_FLOAT,
+	CMD_UNIFORM_VEC4,
+	CMD_UNIFORM_MAT4,
+	CMD_DRAW,
+	CMD_DRAW_INDEXED,
+	CMD_CALL,
+	CMD_TYPE_COUNT
+} CmdType;
+
+typedef enum CmdPrimitive {
+	CMD_POINTS,
+	CMD_LINES,
+	CMD_TRIANGLES,
+	CMD_TRIANGLE_STRIP,
+} CmdPrimitive;
+
+typedef enum CmdIndexType {
+	CMD_INDEX_U16,
+	CMD_INDEX_U32,
+} CmdIndexType;
+
+typedef enum CmdTextureType {
+	CMD_TEXTURE_2D,
+	CMD_TEXTURE_2D_ARRAY,
+	CMD_TEXTURE_BUFFER,
+} CmdTextureType;
+
+enum {
+	CMD_CLEAR_COLOR = 1 << 0,
+	CMD_CLEAR_DEPTH = 1 << 1,
+};
+
+enum {
+	CMD_DEPTH_TEST = 1 << 0,
+	CMD_DEPTH_WRITE = 1 << 1,
+	CMD_BLEND_ADD = 1 << 2,
+	CMD_BLEND_ALPHA = 1 << 3,
+	CMD_CULL_BACK = 1 << 4,
+};
+
+/**
+ * CmdHeader - Header preceding the payload of every command.
+ *
+ * `size` covers the header and the payload, padded to CMD_ALIGN bytes.
+ */
+typedef struct CmdHeader {
+	uint32_t type;
+	uint32_t size;
+} CmdHeader;
+
+#define CMD_ALIGN 8
+
+typedef struct CmdClear {
+	uint32_t flags;
+	float color[4];
+	float depth;
+} CmdClear;
+
+typedef struct CmdState {
+	uint32_t flags;
+} CmdState;
+
+typedef struct CmdViewport {
+	int32_t x, y;
+	uint32_t width, height;
+} CmdViewport;
+
+typedef struct CmdBind {
+	uint32_t handle;
+} CmdBind;
+
+typedef struct CmdTexture {
+	uint32_t unit;
+	uint32_t type;
+	uint32_t handle;
+} CmdTexture;
+
+typedef struct CmdUniformBuffer {
+	uint32_t index;
+	uint32_t handle;
+	uint32_t offset;
+	uint32_t size;
+} CmdUniformBuffer;
+
+typedef struct CmdUniform {
+	int32_t location;
+	uint32_t count;
+	// followed by `count` values of the uniform type
+} CmdUniform;
+
+typedef struct CmdDraw {
+	uint32_t primitive;
+	uint32_t first;
+	uint32_t count;
+	uint32_t instances;
+} CmdDraw;
+
+typedef struct CmdDrawIndexed {
+	uint32_t primitive;
+	uint32_t index_type;
+	uint32_t count;
+	uint32_t offset;
+	int32_t base_vertex;
+	uint32_t instances;
+} CmdDrawIndexed;
+
+typedef struct CmdCall {
+	const struct CmdBuffer *buffer;
+} CmdCall;
+
+/**
+ * CmdBuffer - Growable list of recorded commands.
+ */
+typedef struct CmdBuffer {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	unsigned count;
+	int failed;
+} CmdBuffer;
+
+void
+cmd_init(CmdBuffer *buf);
+
+void
+cmd_free(CmdBuffer *buf);
+
+/**
+ * Empty the buffer for recording a new frame, keeping its storage.
+ */
+void
+cmd_reset(CmdBuffer *buf);
+
+/**
+ * Recording functions.
+ *
+ * Recording never fails immediately: when the buffer can't be grown the
+ * command is dropped and `failed` is set, which replay reports.
+ */
+void
+cmd_clear(CmdBuffer *buf, uint32_t flags, float r, float g, float b, float a, float depth);
+
+void
+cmd_state(CmdBuffer *buf, uint32_t flags);
+
+void
+cmd_viewport(CmdBuffer *buf, int x, int y, unsigned width, unsigned height);
+
+void
+cmd_program(CmdBuffer *buf, uint32_t program);
+
+void
+cmd_vertex_array(CmdBuffer *buf, uint32_t vao);
+
+void
+cmd_texture(CmdBuffer *buf, unsigned unit, CmdTextureType type, uint32_t texture);
+
+void
+cmd_uniform_buffer(CmdBuffer *buf, unsigned index, uint32_t buffer, uint32_t offset, uint32_t size);
+
+void
+cmd_uniform_int(CmdBuffer *buf, int location, int32_t value);
+
+void
+cmd_uniform_float(CmdBuffer *buf, int location, float value);
+
+void
+cmd_uniform_vec4(CmdBuffer *buf, int location, const Vec *v, unsigned count);
+
+/**
+ * Record matrices in matlib row-major order.
+ */
+void
+cmd_uniform_mat4(CmdBuffer *buf, int location, const Mat *m, unsigned count);
+
+void
+cmd_draw(CmdBuffer *buf, CmdPrimitive primitive, unsigned first, unsigned count, unsigned instances);
+
+void
+cmd_draw_indexed(
+	CmdBuffer *buf,
+	CmdPrimitive primitive,
+	CmdIndexType index_type,
+	unsigned count,
+	unsigned offset,
+	int base_vertex,
+	unsigned instances
+);
+
+/**
+ * Replay `callee` at this point; it must stay alive and unchanged until the
+ * buffer is replayed. Calling a buffer which failed recording fails `buf`.
+ */
+void
+cmd_call(CmdBuffer *buf, const CmdBuffer *callee);
+
+/**
+ * CmdRecordFunc - Function recording the part `index` of a frame into `buf`.
+ */
+typedef void (*CmdRecordFunc)(void *data, CmdBuffer *buf, unsigned index);
+
+/**
+ * Reset `count` buffers and record them in parallel on the worker threads,
+ * calling `fn` once per buffer.
+ *
+ * `fn` runs inside job_parallel_for(), so it must not call it itself: the
+ * nested call would wait for the submission lock its caller holds.
+ */
+void
+cmd_record_parallel(CmdBuffer *buffers, unsigned count, CmdRecordFunc fn, void *data);
+
+/**
+ * Iterate over the commands of a buffer: pass a NULL `cursor` to get the
+ * first command; returns NULL past the last one.
+ */
+const CmdHeader*
+cmd_next(const CmdBuffer *buf, const CmdHeader *cursor);
+
+static inline const void*
+cmd_payload(const CmdHeader *cmd)
+{
+	return cmd + 1;
+}
+
+/**
+ * Name of a command type, as written in traces.
+ */
+const char*
+cmd_type_name(uint32_t type);
+
+/*******************************************************************************
+ * Replay to file.
+*******************************************************************************/
+
+/**
+ * CmdStats - Command counts of a replay, calls included.
+ */
+typedef struct CmdStats {
+	unsigned counts[CMD_TYPE_COUNT];
+	unsigned long draw_vertices;
+	size_t bytes;
+} CmdStats;
+
+/**
+ * Write the commands as text, one per line, with called buffers inlined.
+ *
+ * The output only depends on the recorded commands, so traces of two runs can
+ * be compared for regression testing. Returns 1 on success, 0 if the buffer
+ * failed recording or the output could not be written.
+ */
+int
+cmd_write_trace(const CmdBuffer *buf, FILE *out);
+
+/**
+ * Accumulate the statistics of a buffer into `stats`.
+ */
+void
+cmd_stats(const CmdBuffer *buf, CmdStats *stats);
+
+/**
+ * Write the commands in binary form, with called buffers inlined, for loading
+ * back with cmd_load() in offline tools. Returns 1 on success, 0 on failure.
+ */
+int
+cmd_save(const CmdBuffer *buf, FILE *out);
+
+/**
+ * Append the commands saved with cmd_save().
+ *
+ * Every command is checked to be complete and to hold valid enumerations.
+ * Returns 1 on success; on invalid data or failure to grow the buffer, returns
+ * 0 and leaves the buffer as it was.
+ */
+int
+cmd_load(CmdBuffer *buf, FILE *in);
@@ -0,0 +1,195 @@
+#include "cmdbuf_gl.h"
+#include <GL/glew.h>
+#include <stdio.h>
+
+typedef struct ReplayState {
+	GLuint program;
+	GLuint vao;
+	uint32_t flags;
+	int valid;
+} ReplayState;
+
+static const GLenum primitives[] = {
+	GL_POINTS,
+	GL_LINES,
+	GL_TRIANGLES,
+	GL_TRIANGLE_STRIP,
+};
+
+static const GLenum index_types[] = {
+	GL_UNSIGNED_SHORT,
+	GL_UNSIGNED_INT,
+};
+
+static const unsigned index_sizes[] = {
+	sizeof(GLushort),
+	sizeof(GLuint),
+};
+
+static const GLenum texture_targets[] = {
+	GL_TEXTURE_2D,
+	GL_TEXTURE_2D_ARRAY,
+	GL_TEXTURE_BUFFER,
+};
+
+static void
+toggle(GLenum cap, int enable)
+{
+	if (enable) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+}
+
+static void
+apply_state(ReplayState *state, uint32_t flags)
+{
+	uint32_t changed = state->valid ? state->flags ^ flags : ~0u;
+	if (changed & CMD_DEPTH_TEST) {
+		toggle(GL_DEPTH_TEST, flags & CMD_DEPTH_TEST);
+	}
+	if (changed & CMD_DEPTH_WRITE) {
+		glDepthMask(flags & CMD_DEPTH_WRITE ? GL_TRUE : GL_FALSE);
+	}
+	if (changed & (CMD_BLEND_ADD | CMD_BLEND_ALPHA)) {
+		toggle(GL_BLEND, flags & (CMD_BLEND_ADD | CMD_BLEND_ALPHA));
+		if (flags & CMD_BLEND_ADD) {
+			glBlendFunc(GL_ONE, GL_ONE);
+		} else if (flags & CMD_BLEND_ALPHA) {
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+	}
+	if (changed & CMD_CULL_BACK) {
+		toggle(GL_CULL_FACE, flags & CMD_CULL_BACK);
+		glCullFace(GL_BACK);
+	}
+	state->flags = flags;
+	state->valid = 1;
+}
+
+static void
+replay(const CmdBuffer *buf, ReplayState *state)
+{
+	for (const CmdHeader *cmd = cmd_next(buf, NULL); cmd; cmd = cmd_next(buf, cmd)) {
+		const void *p = cmd_payload(cmd);
+
+		switch (cmd->type) {
+		case CMD_CLEAR: {
+			const CmdClear *c = p;
+			GLbitfield mask = 0;
+			if (c->flags & CMD_CLEAR_COLOR) {
+				glClearColor(c->color[0], c->color[1], c->color[2], c->color[3]);
+				mask |= GL_COLOR_BUFFER_BIT;
+			}
+			// depth clears honour the depth mask
+			int unmask = (c->flags & CMD_CLEAR_DEPTH) && state->valid && !(state->flags & CMD_DEPTH_WRITE);
+			if (c->flags & CMD_CLEAR_DEPTH) {
+				glClearDepth(c->depth);
+				mask |= GL_DEPTH_BUFFER_BIT;
+			}
+			if (unmask) {
+				glDepthMask(GL_TRUE);
+			}
+			glClear(mask);
+			if (unmask) {
+				glDepthMask(GL_FALSE);
+			}
+			break;
+		}
+		case CMD_STATE:
+			apply_state(state, ((const CmdState*)p)->flags);
+			break;
+		case CMD_VIEWPORT: {
+			const CmdViewport *c = p;
+			glViewport(c->x, c->y, c->width, c->height);
+			break;
+		}
+		case CMD_PROGRAM: {
+			GLuint program = ((const CmdBind*)p)->handle;
+			if (program != state->program) {
+				glUseProgram(program);
+				state->program = program;
+			}
+			break;
+		}
+		case CMD_VERTEX_ARRAY: {
+			GLuint vao = ((const CmdBind*)p)->handle;
+			if (vao != state->vao) {
+				glBindVertexArray(vao);
+				state->vao = vao;
+			}
+			break;
+		}
+		case CMD_TEXTURE: {
+			const CmdTexture *c = p;
+			glActiveTexture(GL_TEXTURE0 + c->unit);
+			glBindTexture(texture_targets[c->type], c->handle);
+			break;
+		}
+		case CMD_UNIFORM_BUFFER: {
+			const CmdUniformBuffer *c = p;
+			if (c->size) {
+				glBindBufferRange(GL_UNIFORM_BUFFER, c->index, c->handle, c->offset, c->size);
+			} else {
+				glBindBufferBase(GL_UNIFORM_BUFFER, c->index, c->handle);
+			}
+			break;
+		}
+		case CMD_UNIFORM_INT: {
+			const CmdUniform *c = p;
+			glUniform1iv(c->location, c->count, (const GLint*)(c + 1));
+			break;
+		}
+		case CMD_UNIFORM_FLOAT: {
+			const CmdUniform *c = p;
+			glUniform1fv(c->location, c->count, (const GLfloat*)(c + 1));
+			break;
+		}
+		case CMD_UNIFORM_VEC4: {
+			const CmdUniform *c = p;
+			glUniform4fv(c->location, c->count, (const GLfloat*)(c + 1));
+			break;
+		}
+		case CMD_UNIFORM_MAT4: {
+			const CmdUniform *c = p;
+			glUniformMatrix4fv(c->location, c->count, GL_TRUE, (const GLfloat*)(c + 1));
+			break;
+		}
+		case CMD_DRAW: {
+			const CmdDraw *c = p;
+			glDrawArraysInstanced(primitives[c->primitive], c->first, c->count, c->instances);
+			break;
+		}
+		case CMD_DRAW_INDEXED: {
+			const CmdDrawIndexed *c = p;
+			glDrawElementsInstancedBaseVertex(
+				primitives[c->primitive],
+				c->count,
+				index_types[c->index_type],
+				(const void*)(uintptr_t)(c->offset * index_sizes[c->index_type]),
+				c->instances,
+				c->base_vertex
+			);
+			break;
+		}
+		case CMD_CALL:
+			replay(((const CmdCall*)p)->buffer, state);
+			break;
+		}
+	}
+}
+
+int
+cmd_gl_replay(const CmdBuffer *buf)
+{
+	if (buf->failed) {
+		fprintf(stderr, "command buffer failed recording\n");
+		return 0;
+	}
+
+	// the program and vertex array in use are unknown, bind them again
+	ReplayState state = { ~0u, ~0u, 0, 0 };
+	replay(buf, &state);
+	return 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "cmdbuf.h"
+
+/**
+ * Replay a command buffer through GL on the thread owning the context.
+ *
+ * Binds which would not change the program, vertex array or pipeline state
+ * left by the previous command are skipped; state set outside command
+ * buffers is not tracked, so each top-level replay starts by re-applying it.
+ *
+ * Returns 1 on success, 0 if the buffer failed recording, in which case
+ * nothing is replayed.
+ */
+int
+cmd_gl_replay(const CmdBuffer *buf);
@@ -0,0 +1,114 @@
+#include "cmdbuf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Inspection of command buffers saved with cmd_save(), for instance by the
+ * demo's --capture option, without a graphics context.
+ *
+ * Prints the command statistics of a file, optionally its trace, and when
+ * given a second file, compares the two command by command. Exits with a
+ * failure status when a file is invalid or the files differ.
+ */
+
+static int
+load(CmdBuffer *buf, const char *path)
+{
+	FILE *in = fopen(path, "rb");
+	if (!in) {
+		fprintf(stderr, "failed to open %s\n", path);
+		return 0;
+	}
+	int ok = cmd_load(buf, in);
+	fclose(in);
+	if (!ok) {
+		fprintf(stderr, "failed to load %s\n", path);
+	}
+	return ok;
+}
+
+static void
+print_stats(const CmdBuffer *buf, const char *path)
+{
+	CmdStats stats;
+	memset(&stats, 0, sizeof(stats));
+	cmd_stats(buf, &stats);
+
+	printf("%s: %u commands, %zu bytes, %lu vertices drawn\n",
+		path, buf->count, stats.bytes, stats.draw_vertices);
+	for (unsigned t = 0; t < CMD_TYPE_COUNT; t++) {
+		if (stats.counts[t] > 0) {
+			printf("  %-16s %8u\n", cmd_type_name(t), stats.counts[t]);
+		}
+	}
+}
+
+/*
+ * Compare two buffers, returning 1 if they hold the same commands.
+ */
+static int
+compare(const CmdBuffer *a, const CmdBuffer *b)
+{
+	const CmdHeader *ca = cmd_next(a, NULL), *cb = cmd_next(b, NULL);
+	unsigned index = 0;
+	for (; ca && cb; ca = cmd_next(a, ca), cb = cmd_next(b, cb), index++) {
+		if (ca->size != cb->size || memcmp(ca, cb, ca->size) != 0) {
+			printf("first difference at command %u: %s, %s\n",
+				index, cmd_type_name(ca->type), cmd_type_name(cb->type));
+			return 0;
+		}
+	}
+	if (ca || cb) {
+		printf("first difference at command %u: %s, %s\n", index,
+			ca ? cmd_type_name(ca->type) : "end", cb ? cmd_type_name(cb->type) : "end");
+		return 0;
+	}
+	printf("identical\n");
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int want_trace = 0;
+	const char *paths[2] = { NULL, NULL };
+	unsigned path_count = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--trace") == 0) {
+			want_trace = 1;
+		} else if (argv[i][0] != '-' && path_count < 2) {
+			paths[path_count++] = argv[i];
+		} else {
+			path_count = 0;
+			break;
+		}
+	}
+	if (path_count == 0) {
+		fprintf(stderr, "usage: %s [--trace] FILE [OTHER]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	CmdBuffer bufs[2];
+	cmd_init(&bufs[0]);
+	cmd_init(&bufs[1]);
+	int status = EXIT_SUCCESS;
+	for (unsigned i = 0; i < path_count; i++) {
+		if (!load(&bufs[i], paths[i])) {
+			status = EXIT_FAILURE;
+			break;
+		}
+		print_stats(&bufs[i], paths[i]);
+		if (want_trace && !cmd_write_trace(&bufs[i], stdout)) {
+			status = EXIT_FAILURE;
+			break;
+		}
+	}
+	if (status == EXIT_SUCCESS && path_count == 2 && !compare(&bufs[0], &bufs[1])) {
+		status = EXIT_FAILURE;
+	}
+
+	cmd_free(&bufs[1]);
+	cmd_free(&bufs[0]);
+	return status;
+}
@@ -0,0 +1,340 @@
+#include "fmath.h"
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#define PI_F 3.14159265358979f
+#define PI_2_F 1.57079632679490f
+#define PI_4_F 0.78539816339745f
+#define TAN_PI_8_F 0.41421356237310f
+
+// pi/2 split in two parts for Cody-Waite range reduction in double
+// precision: PIO2_HI has 30 significant bits, so that j * PIO2_HI and
+// x - j * PIO2_HI are exact for |x| <= FM_SINCOS_MAX, and the remainder
+// keeps its relative accuracy even next to multiples of pi/2
+#define PIO2_HI 1.570796325802803
+#define PIO2_LO 9.920935796805404e-10
+
+// minimax coefficients on [-pi/4, pi/4]
+#define S1 -1.6666654611e-1f
+#define S2 8.3321608736e-3f
+#define S3 -1.9515295891e-4f
+#define C1 4.166664568298827e-2f
+#define C2 -1.388731625493765e-3f
+#define C3 2.443315711809948e-5f
+
+// asin(x) on [0, 0.5]
+#define A1 1.6666752422e-1f
+#define A2 7.4953002686e-2f
+#define A3 4.5470025998e-2f
+#define A4 2.4181311049e-2f
+#define A5 4.2163199048e-2f
+
+// atan(x) on [-tan(pi/8), tan(pi/8)]
+#define T1 -3.33329491539e-1f
+#define T2 1.99777106478e-1f
+#define T3 -1.38776856032e-1f
+#define T4 8.05374449538e-2f
+
+void
+fm_sincos(float x, float *r_sin, float *r_cos)
+{
+	if (!(fabsf(x) <= FM_SINCOS_MAX)) {
+		*r_sin = *r_cos = NAN;
+		return;
+	}
+
+	// round to nearest quadrant, ties to even like the stream version
+	float j = x * (2.0f / PI_F);
+#ifdef __SSE2__
+	int q = _mm_cvtss_si32(_mm_set_ss(j));
+#else
+	int q = (int)lrintf(j);
+#endif
+	j = (float)q;
+
+	float r = (float)(((double)x - j * PIO2_HI) - j * PIO2_LO);
+	float z = r * r;
+	float s = r + r * z * (S1 + z * (S2 + z * S3));
+	float c = 1.0f - 0.5f * z + z * z * (C1 + z * (C2 + z * C3));
+
+	switch (q & 3) {
+	case 0: *r_sin = s;  *r_cos = c;  break;
+	case 1: *r_sin = c;  *r_cos = -s; break;
+	case 2: *r_sin = -s; *r_cos = -c; break;
+	case 3: *r_sin = -c; *r_cos = s;  break;
+	}
+}
+
+float
+fm_sin(float x)
+{
+	float s, c;
+	fm_sincos(x, &s, &c);
+	return s;
+}
+
+float
+fm_cos(float x)
+{
+	float s, c;
+	fm_sincos(x, &s, &c);
+	return c;
+}
+
+float
+fm_acos(float x)
+{
+	float a = x < 0 ? -x : x;
+	if (a > 1.0f) {
+		return NAN;
+	}
+
+	if (a <= 0.5f) {
+		float z = x * x;
+		float p = ((((A5 * z + A4) * z + A3) * z + A2) * z + A1) * z;
+		return PI_2_F - (x + x * p);
+	}
+
+	// acos(a) = 2 * asin(sqrt((1 - a) / 2))
+	float z = 0.5f * (1.0f - a);
+	float s = sqrtf(z);
+	float p = ((((A5 * z + A4) * z + A3) * z + A2) * z + A1) * z;
+	float r = 2.0f * (s + s * p);
+	return x < 0 ? PI_F - r : r;
+}
+
+float
+fm_atan2(float y, float x)
+{
+	float ax = x < 0 ? -x : x;
+	float ay = y < 0 ? -y : y;
+	float hi = ax > ay ? ax : ay;
+	float lo = ax > ay ? ay : ax;
+	if (hi == 0) {
+		return 0;
+	}
+
+	// reduce to atan(t) in [0, 1], then to [-tan(pi/8), tan(pi/8)]
+	float t = lo / hi, base = 0;
+	if (t > TAN_PI_8_F) {
+		t = (t - 1.0f) / (t + 1.0f);
+		base = PI_4_F;
+	}
+	float z = t * t;
+	float r = base + t + t * z * (T1 + z * (T2 + z * (T3 + z * T4)));
+
+	if (ay > ax) {
+		r = PI_2_F - r;
+	}
+	if (x < 0) {
+		r = PI_F - r;
+	}
+	return y < 0 ? -r : r;
+}
+
+float
+fm_rsqrt(float x)
+{
+#ifdef __SSE2__
+	float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+	return y * (1.5f - 0.5f * x * y * y);
+#else
+	unsigned i;
+	float y;
+	memcpy(&i, &x, sizeof(i));
+	i = 0x5f375a86 - (i >> 1);
+	memcpy(&y, &i, sizeof(y));
+	// the initial guess is only good to 3.4%, take three steps to reach the
+	// accuracy of the refined hardware estimate
+	y = y * (1.5f - 0.5f * x * y * y);
+	y = y * (1.5f - 0.5f * x * y * y);
+	return y * (1.5f - 0.5f * x * y * y);
+#endif
+}
+
+#ifdef __SSE2__
+
+static inline __m128
+select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128
+abs_ps(__m128 x)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+static inline __m128
+sign_ps(__m128 x)
+{
+	return _mm_and_ps(_mm_set1_ps(-0.0f), x);
+}
+
+static void
+sincos_ps(__m128 x, __m128 *r_sin, __m128 *r_cos)
+{
+	// round to nearest quadrant; out of range arguments give NaN
+	__m128 invalid = _mm_cmpnle_ps(abs_ps(x), _mm_set1_ps(FM_SINCOS_MAX));
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(2.0f / PI_F)));
+	__m128d j_lo = _mm_cvtepi32_pd(q);
+	__m128d j_hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(q, _MM_SHUFFLE(3, 2, 3, 2)));
+	__m128d x_lo = _mm_cvtps_pd(x);
+	__m128d x_hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+
+	x_lo = _mm_sub_pd(x_lo, _mm_mul_pd(j_lo, _mm_set1_pd(PIO2_HI)));
+	x_lo = _mm_sub_pd(x_lo, _mm_mul_pd(j_lo, _mm_set1_pd(PIO2_LO)));
+	x_hi = _mm_sub_pd(x_hi, _mm_mul_pd(j_hi, _mm_set1_pd(PIO2_HI)));
+	x_hi = _mm_sub_pd(x_hi, _mm_mul_pd(j_hi, _mm_set1_pd(PIO2_LO)));
+	__m128 r = _mm_movelh_ps(_mm_cvtpd_ps(x_lo), _mm_cvtpd_ps(x_hi));
+	__m128 z = _mm_mul_ps(r, r);
+
+	__m128 ps = _mm_add_ps(_mm_set1_ps(S2), _mm_mul_ps(z, _mm_set1_ps(S3)));
+	ps = _mm_add_ps(_mm_set1_ps(S1), _mm_mul_ps(z, ps));
+	__m128 s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), ps));
+
+	__m128 pc = _mm_add_ps(_mm_set1_ps(C2), _mm_mul_ps(z, _mm_set1_ps(C3)));
+	pc = _mm_add_ps(_mm_set1_ps(C1), _mm_mul_ps(z, pc));
+	__m128 c = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+	c = _mm_add_ps(c, _mm_mul_ps(_mm_mul_ps(z, z), pc));
+
+	// odd quadrants swap sine and cosine, quadrants 1, 2 negate the cosine
+	// and quadrants 2, 3 the sine
+	__m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+	__m128 sin_neg = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+	__m128 cos_neg = _mm_castsi128_ps(_mm_slli_epi32(
+		_mm_and_si128(_mm_add_epi32(q, one), two),
+		30
+	));
+
+	*r_sin = _mm_or_ps(_mm_xor_ps(select_ps(swap, c, s), sin_neg), invalid);
+	*r_cos = _mm_or_ps(_mm_xor_ps(select_ps(swap, s, c), cos_neg), invalid);
+}
+
+static __m128
+acos_ps(__m128 x)
+{
+	__m128 a = abs_ps(x);
+	__m128 big = _mm_cmpgt_ps(a, _mm_set1_ps(0.5f));
+
+	// evaluate both branches of fm_acos() on the same polynomial
+	__m128 zb = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(_mm_set1_ps(1.0f), a));
+	__m128 z = select_ps(big, zb, _mm_mul_ps(x, x));
+	__m128 s = select_ps(big, _mm_sqrt_ps(zb), x);
+
+	__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A5), z), _mm_set1_ps(A4));
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(A3));
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(A2));
+	p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(A1));
+	p = _mm_mul_ps(p, z);
+	__m128 asin = _mm_add_ps(s, _mm_mul_ps(s, p));
+
+	__m128 small_r = _mm_sub_ps(_mm_set1_ps(PI_2_F), asin);
+	__m128 big_r = _mm_add_ps(asin, asin);
+	__m128 neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+	big_r = select_ps(neg, _mm_sub_ps(_mm_set1_ps(PI_F), big_r), big_r);
+
+	return select_ps(big, big_r, small_r);
+}
+
+static __m128
+atan2_ps(__m128 y, __m128 x)
+{
+	__m128 ax = abs_ps(x), ay = abs_ps(y);
+	__m128 hi = _mm_max_ps(ax, ay), lo = _mm_min_ps(ax, ay);
+	__m128 zero = _mm_cmpeq_ps(hi, _mm_setzero_ps());
+	__m128 t = _mm_div_ps(lo, select_ps(zero, _mm_set1_ps(1.0f), hi));
+
+	__m128 reduce = _mm_cmpgt_ps(t, _mm_set1_ps(TAN_PI_8_F));
+	__m128 tr = _mm_div_ps(
+		_mm_sub_ps(t, _mm_set1_ps(1.0f)),
+		_mm_add_ps(t, _mm_set1_ps(1.0f))
+	);
+	t = select_ps(reduce, tr, t);
+	__m128 base = _mm_and_ps(reduce, _mm_set1_ps(PI_4_F));
+
+	__m128 z = _mm_mul_ps(t, t);
+	__m128 p = _mm_add_ps(_mm_set1_ps(T3), _mm_mul_ps(z, _mm_set1_ps(T4)));
+	p = _mm_add_ps(_mm_set1_ps(T2), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(T1), _mm_mul_ps(z, p));
+	__m128 r = _mm_add_ps(base, _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, z), p)));
+
+	r = select_ps(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(PI_2_F), r), r);
+	r = select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI_F), r), r);
+	r = _mm_or_ps(r, sign_ps(y));
+	return _mm_andnot_ps(zero, r);
+}
+
+static __m128
+rsqrt_ps(__m128 x)
+{
+	__m128 y = _mm_rsqrt_ps(x);
+	__m128 yy = _mm_mul_ps(_mm_mul_ps(x, y), y);
+	return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_set1_ps(0.5f), yy)));
+}
+
+#endif
+
+void
+fm_sincos_v(const float *x, float *r_sin, float *r_cos, unsigned count)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= count; i += 4) {
+		__m128 s, c;
+		sincos_ps(_mm_loadu_ps(x + i), &s, &c);
+		_mm_storeu_ps(r_sin + i, s);
+		_mm_storeu_ps(r_cos + i, c);
+	}
+#endif
+	for (; i < count; i++) {
+		fm_sincos(x[i], &r_sin[i], &r_cos[i]);
+	}
+}
+
+void
+fm_acos_v(const float *x, float *r, unsigned count)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(r + i, acos_ps(_mm_loadu_ps(x + i)));
+	}
+#endif
+	for (; i < count; i++) {
+		r[i] = fm_acos(x[i]);
+	}
+}
+
+void
+fm_atan2_v(const float *y, const float *x, float *r, unsigned count)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(r + i, atan2_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+	}
+#endif
+	for (; i < count; i++) {
+		r[i] = fm_atan2(y[i], x[i]);
+	}
+}
+
+void
+fm_rsqrt_v(const float *x, float *r, unsigned count)
+{
+	unsigned i = 0;
+#ifdef __SSE2__
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(r + i, rsqrt_ps(_mm_loadu_ps(x + i)));
+	}
+#endif
+	for (; i < count; i++) {
+		r[i] = fm_rsqrt(x[i]);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <math.h>
+
+/*******************************************************************************
+ * Single-precision transcendental functions.
+ *
+ * The polynomial approximations are evaluated in single precision; only the
+ * range reduction of sine and cosine uses double precision, so that they
+ * keep their relative accuracy next to multiples of pi/2. The bounds below
+ * are the maximum errors against the double precision C library, in ULP of
+ * the float result, as measured by `make accuracy` for |x| <= FM_SINCOS_MAX
+ * (sine and cosine), [-1, 1] (acos), [-100, 100] (atan2) and [1e-6, 1e6]
+ * (rsqrt).
+*******************************************************************************/
+
+#define FM_SINCOS_ULP 2
+#define FM_ACOS_ULP 2
+#define FM_ATAN2_ULP 4
+#define FM_RSQRT_ULP 4
+
+// largest argument of sine and cosine
+#define FM_SINCOS_MAX 1048576.0f
+
+/**
+ * Sine and cosine of |x| <= FM_SINCOS_MAX; larger, infinite or NaN arguments
+ * give NaN. The scalar and stream versions return identical results.
+ */
+void
+fm_sincos(float x, float *r_sin, float *r_cos);
+
+float
+fm_sin(float x);
+
+float
+fm_cos(float x);
+
+float
+fm_acos(float x);
+
+float
+fm_atan2(float y, float x);
+
+/**
+ * Reciprocal square root: hardware estimate refined by a Newton-Raphson step.
+ */
+float
+fm_rsqrt(float x);
+
+/**
+ * Stream versions of the above, processing four elements at a time.
+ */
+void
+fm_sincos_v(const float *x, float *r_sin, float *r_cos, unsigned count);
+
+void
+fm_acos_v(const float *x, float *r, unsigned count);
+
+void
+fm_atan2_v(const float *y, const float *x, float *r, unsigned count);
+
+void
+fm_rsqrt_v(const float *x, float *r, unsigned count);
+
+/*******************************************************************************
+ * Precision tier used by matlib.
+ *
+ * Building with MATLIB_FAST_MATH defined selects the approximations above,
+ * otherwise the single-precision C library functions are used.
+*******************************************************************************/
+
+#ifdef MATLIB_FAST_MATH
+# define ml_sincos(x, s, c) fm_sincos((x), (s), (c))
+# define ml_rsqrt(x) fm_rsqrt(x)
+#else
+# define ml_sincos(x, s, c) (*(s) = sinf(x), *(c) = cosf(x))
+# define ml_rsqrt(x) (1.0f / sqrtf(x))
+#endif
@@ -0,0 +1,225 @@
+#include "fmath.h"
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Accuracy check of the fmath approximations.
+ *
+ * Evaluates every function, scalar and stream versions, on random arguments
+ * over its domain, half of them next to multiples of pi/2 for sine and
+ * cosine, and reports the largest error against the double precision
+ * C library in units in the last place of the float result. Sine and cosine
+ * are also checked to give identical scalar and stream results, and NaN past
+ * their domain. Exits with a failure status when an error exceeds the bound
+ * documented in fmath.h or a check fails.
+ */
+
+#define DEFAULT_SAMPLES 1000000
+#define PI_2 1.57079632679489661923
+
+typedef struct Check {
+	const char *name;
+	float lo, hi;
+	int log_scale;
+	int near_axes;
+	int identical;
+	double bound;
+	double (*ref)(double x, double y);
+	float (*scalar)(float x, float y);
+	void (*stream)(const float *x, const float *y, float *r, unsigned count);
+} Check;
+
+static uint32_t seed = 0x2545f491;
+
+static float
+rand_float(float lo, float hi, int log_scale)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	float t = (seed >> 8) * (1.0f / 16777216.0f);
+	if (log_scale) {
+		return lo * powf(hi / lo, t);
+	}
+	return lo + (hi - lo) * t;
+}
+
+/*
+ * Arguments within a few ULP of a multiple of pi/2, where sine or cosine
+ * cancel and range reduction errors show up.
+ */
+static float
+near_axis(float lo, float hi)
+{
+	int k = (int)(rand_float(lo, hi, 0) / PI_2);
+	float x = (float)(k * PI_2);
+	int steps = (int)rand_float(-8, 9, 0);
+	for (; steps > 0; steps--) {
+		x = nextafterf(x, INFINITY);
+	}
+	for (; steps < 0; steps++) {
+		x = nextafterf(x, -INFINITY);
+	}
+	return x;
+}
+
+static double
+ulp_error(float got, double ref)
+{
+	if (isnan(got) || isnan(ref)) {
+		return isnan(got) && isnan(ref) ? 0 : INFINITY;
+	}
+	double ulp = fabs(ref) < FLT_MIN ? ldexp(1.0, -149) : ldexp(1.0, ilogb(ref) - 23);
+	return fabs(got - ref) / ulp;
+}
+
+static double ref_sin(double x, double y) { (void)y; return sin(x); }
+static double ref_cos(double x, double y) { (void)y; return cos(x); }
+static double ref_acos(double x, double y) { (void)y; return acos(x); }
+static double ref_atan2(double x, double y) { return atan2(x, y); }
+static double ref_rsqrt(double x, double y) { (void)y; return 1.0 / sqrt(x); }
+
+static float fm_sin2(float x, float y) { (void)y; return fm_sin(x); }
+static float fm_cos2(float x, float y) { (void)y; return fm_cos(x); }
+static float fm_acos2(float x, float y) { (void)y; return fm_acos(x); }
+static float fm_rsqrt2(float x, float y) { (void)y; return fm_rsqrt(x); }
+
+static float *scratch;
+
+static void
+sin_v(const float *x, const float *y, float *r, unsigned count)
+{
+	(void)y;
+	fm_sincos_v(x, r, scratch, count);
+}
+
+static void
+cos_v(const float *x, const float *y, float *r, unsigned count)
+{
+	(void)y;
+	fm_sincos_v(x, scratch, r, count);
+}
+
+static void
+acos_v(const float *x, const float *y, float *r, unsigned count)
+{
+	(void)y;
+	fm_acos_v(x, r, count);
+}
+
+static void
+rsqrt_v(const float *x, const float *y, float *r, unsigned count)
+{
+	(void)y;
+	fm_rsqrt_v(x, r, count);
+}
+
+static const Check checks[] = {
+	{ "sin", -100, 100, 0, 1, 1, FM_SINCOS_ULP, ref_sin, fm_sin2, sin_v },
+	{ "cos", -100, 100, 0, 1, 1, FM_SINCOS_ULP, ref_cos, fm_cos2, cos_v },
+	{ "sin", -8192, 8192, 0, 1, 1, FM_SINCOS_ULP, ref_sin, fm_sin2, sin_v },
+	{ "cos", -8192, 8192, 0, 1, 1, FM_SINCOS_ULP, ref_cos, fm_cos2, cos_v },
+	{ "sin", -FM_SINCOS_MAX, FM_SINCOS_MAX, 0, 1, 1, FM_SINCOS_ULP, ref_sin, fm_sin2, sin_v },
+	{ "cos", -FM_SINCOS_MAX, FM_SINCOS_MAX, 0, 1, 1, FM_SINCOS_ULP, ref_cos, fm_cos2, cos_v },
+	{ "acos", -1, 1, 0, 0, 0, FM_ACOS_ULP, ref_acos, fm_acos2, acos_v },
+	{ "atan2", -100, 100, 0, 0, 0, FM_ATAN2_ULP, ref_atan2, fm_atan2, fm_atan2_v },
+	{ "rsqrt", 1e-6f, 1e6f, 1, 0, 0, FM_RSQRT_ULP, ref_rsqrt, fm_rsqrt2, rsqrt_v },
+};
+
+int
+main(int argc, char *argv[])
+{
+	unsigned samples = DEFAULT_SAMPLES;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--samples=", 10) == 0 && atoi(argv[i] + 10) > 0) {
+			samples = atoi(argv[i] + 10);
+		} else {
+			fprintf(stderr, "usage: %s [--samples=N]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	float *x = malloc(samples * sizeof(float));
+	float *y = malloc(samples * sizeof(float));
+	float *r = malloc(samples * sizeof(float));
+	scratch = malloc(samples * sizeof(float));
+	if (!x || !y || !r || !scratch) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_SUCCESS;
+	printf("%-6s %-28s %8s %14s %8s %14s %6s\n",
+		"func", "domain", "scalar", "at", "stream", "at", "bound");
+	for (unsigned c = 0; c < sizeof(checks) / sizeof(checks[0]); c++) {
+		const Check *check = &checks[c];
+		for (unsigned i = 0; i < samples; i++) {
+			if (check->near_axes && i % 2) {
+				x[i] = near_axis(check->lo, check->hi);
+			} else {
+				x[i] = rand_float(check->lo, check->hi, check->log_scale);
+			}
+			y[i] = rand_float(check->lo, check->hi, check->log_scale);
+		}
+		check->stream(x, y, r, samples);
+
+		double max_scalar = 0, max_stream = 0;
+		float at_scalar = 0, at_stream = 0;
+		unsigned mismatches = 0;
+		for (unsigned i = 0; i < samples; i++) {
+			double ref = check->ref(x[i], y[i]);
+			float got = check->scalar(x[i], y[i]);
+			if (check->identical && memcmp(&got, &r[i], sizeof(float)) != 0) {
+				mismatches++;
+			}
+			double err = ulp_error(got, ref);
+			if (err > max_scalar) {
+				max_scalar = err;
+				at_scalar = x[i];
+			}
+			err = ulp_error(r[i], ref);
+			if (err > max_stream) {
+				max_stream = err;
+				at_stream = x[i];
+			}
+		}
+
+		char domain[32];
+		snprintf(domain, sizeof(domain), "[%g, %g]", check->lo, check->hi);
+		int ok = max_scalar <= check->bound && max_stream <= check->bound && mismatches == 0;
+		printf("%-6s %-28s %8.2f %14.7g %8.2f %14.7g %6g%s\n",
+			check->name, domain, max_scalar, at_scalar, max_stream, at_stream,
+			check->bound, ok ? "" : "  FAIL");
+		if (mismatches > 0) {
+			printf("       %u stream results differ from scalar ones\n", mismatches);
+		}
+		if (!ok) {
+			status = EXIT_FAILURE;
+		}
+	}
+
+	// past the domain of sine and cosine, in both versions
+	const float outside[8] = {
+		nextafterf(FM_SINCOS_MAX, INFINITY), -nextafterf(FM_SINCOS_MAX, INFINITY),
+		2 * FM_SINCOS_MAX, -3.4e38f, FLT_MAX, INFINITY, -INFINITY, NAN,
+	};
+	float out_sin[8], out_cos[8];
+	fm_sincos_v(outside, out_sin, out_cos, 8);
+	for (unsigned i = 0; i < 8; i++) {
+		float s, c;
+		fm_sincos(outside[i], &s, &c);
+		if (!isnan(s) || !isnan(c) || !isnan(out_sin[i]) || !isnan(out_cos[i])) {
+			printf("sincos(%g) is not NaN  FAIL\n", outside[i]);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	free(scratch);
+	free(r);
+	free(y);
+	free(x);
+	return status;
+}
@@ -0,0 +1,90 @@
+#include "frame.h"
+#include <stdlib.h>
+
+#define FRESH 4
+
+FrameExchange*
+frame_exchange_new(void)
+{
+	FrameExchange *ex = calloc(1, sizeof(FrameExchange));
+	if (ex) {
+		ex->back = 0;
+		ex->front = 1;
+		SDL_AtomicSet(&ex->middle, 2);
+	}
+	return ex;
+}
+
+void
+frame_exchange_free(FrameExchange *ex)
+{
+	free(ex);
+}
+
+Frame*
+frame_back(FrameExchange *ex)
+{
+	return &ex->frames[ex->back];
+}
+
+void
+frame_publish(FrameExchange *ex)
+{
+	// make the frame contents visible before handing it over
+	SDL_MemoryBarrierRelease();
+	int old = SDL_AtomicSet(&ex->middle, ex->back | FRESH);
+	ex->back = old & ~FRESH;
+}
+
+const Frame*
+frame_latest(FrameExchange *ex)
+{
+	if (SDL_AtomicGet(&ex->middle) & FRESH) {
+		int old = SDL_AtomicSet(&ex->middle, ex->front);
+		SDL_MemoryBarrierAcquire();
+		ex->front = old & ~FRESH;
+	}
+	return &ex->frames[ex->front];
+}
+
+void
+frame_object_transform(const FrameObject *obj, double alpha, DMat *r_world)
+{
+	DVec pos;
+	Qtr rot;
+	DQtr drot;
+	dvec_lerp(&obj->prev_pos, &obj->pos, alpha, &pos);
+	qtr_lerp(&obj->prev_rot, &obj->rot, (float)alpha, &rot);
+	qtr_to_dqtr(&rot, &drot);
+	dmat_compose(r_world, &pos, &drot, &obj->scale);
+}
+
+int
+input_push(InputQueue *q, const SDL_Event *event, double time)
+{
+	unsigned head = SDL_AtomicGet(&q->head);
+	if (head - (unsigned)SDL_AtomicGet(&q->tail) == INPUT_QUEUE_SIZE) {
+		return 0;
+	}
+
+	InputEvent *e = &q->events[head % INPUT_QUEUE_SIZE];
+	e->time = time;
+	e->event = *event;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&q->head, head + 1);
+	return 1;
+}
+
+int
+input_pop(InputQueue *q, InputEvent *r_event)
+{
+	unsigned tail = SDL_AtomicGet(&q->tail);
+	if (tail == (unsigned)SDL_AtomicGet(&q->head)) {
+		return 0;
+	}
+
+	SDL_MemoryBarrierAcquire();
+	*r_event = q->events[tail % INPUT_QUEUE_SIZE];
+	SDL_AtomicSet(&q->tail, tail + 1);
+	return 1;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "matlib.h"
+#include <SDL.h>
+
+#define FRAME_MAX_OBJECTS 4096
+#define INPUT_QUEUE_SIZE 256
+
+/*******************************************************************************
+ * Frame snapshots exchanged between the simulation and the render thread.
+*******************************************************************************/
+
+/**
+ * FrameObject - Drawable object with its state at the two last simulation
+ * steps, which the renderer interpolates between. Positions and scale are in
+ * double-precision world coordinates.
+ */
+typedef struct FrameObject {
+	DVec prev_pos, pos;
+	Qtr prev_rot, rot;
+	DVec scale;
+	unsigned mesh;
+} FrameObject;
+
+/**
+ * Frame - Immutable snapshot of the simulation, holding the transforms and
+ * the draw list of a frame.
+ */
+typedef struct Frame {
+	unsigned long tick;
+	double time;          // simulation time of the current state
+	double step;          // simulation time step
+	double input_time;    // time of the newest input event applied, or 0
+	unsigned object_count;
+	FrameObject objects[FRAME_MAX_OBJECTS];
+} Frame;
+
+/**
+ * FrameExchange - Lock-free triple buffer of snapshots.
+ *
+ * The producer always has a back frame to write to and the consumer a front
+ * frame to read from; publishing and fetching swap them with the middle
+ * frame, so neither side ever waits for the other.
+ */
+typedef struct FrameExchange {
+	Frame frames[3];
+	SDL_atomic_t middle;
+	int back;
+	int front;
+} FrameExchange;
+
+/**
+ * Allocate and initialize an exchange with empty frames.
+ */
+FrameExchange*
+frame_exchange_new(void);
+
+void
+frame_exchange_free(FrameExchange *ex);
+
+/**
+ * Producer side: frame to write the next snapshot into.
+ */
+Frame*
+frame_back(FrameExchange *ex);
+
+/**
+ * Producer side: make the back frame available to the consumer.
+ */
+void
+frame_publish(FrameExchange *ex);
+
+/**
+ * Consumer side: most recently published frame.
+ */
+const Frame*
+frame_latest(FrameExchange *ex);
+
+/**
+ * Interpolate the world transform of an object in double precision, `alpha`
+ * going from the previous state (0) to the current one (1).
+ */
+void
+frame_object_transform(const FrameObject *obj, double alpha, DMat *r_world);
+
+
+/*******************************************************************************
+ * Input events forwarded from the event thread to the simulation.
+*******************************************************************************/
+
+typedef struct InputEvent {
+	double time;
+	SDL_Event event;
+} InputEvent;
+
+/**
+ * InputQueue - Lock-free single producer, single consumer ring of events.
+ */
+typedef struct InputQueue {
+	InputEvent events[INPUT_QUEUE_SIZE];
+	SDL_atomic_t head;
+	SDL_atomic_t tail;
+} InputQueue;
+
+/**
+ * Push an event, returns 0 if the queue is full.
+ */
+int
+input_push(InputQueue *q, const SDL_Event *event, double time);
+
+/**
+ * Pop the oldest event, returns 0 if the queue is empty.
+ */
+int
+input_pop(InputQueue *q, InputEvent *r_event);
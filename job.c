@@ -0,0 +1,176 @@
+#include "job.h"
+#include <SDL.h>
+
+static struct {
+	SDL_Thread *threads[JOB_MAX_WORKERS];
+	unsigned count;
+	SDL_mutex *lock;
+	SDL_mutex *submit_lock;
+	SDL_cond *wake;
+	SDL_cond *done;
+	unsigned generation;
+	unsigned active;
+	int quit;
+
+	// current job
+	JobFunc fn;
+	void *data;
+	unsigned total;
+	unsigned grain;
+	SDL_atomic_t next;
+} pool;
+
+static void
+run_chunks(void)
+{
+	const unsigned grain = pool.grain;
+	const unsigned total = pool.total;
+	for (;;) {
+		unsigned begin = (unsigned)SDL_AtomicAdd(&pool.next, grain);
+		if (begin >= total) {
+			break;
+		}
+		unsigned end = begin + grain < total ? begin + grain : total;
+		pool.fn(pool.data, begin, end);
+	}
+}
+
+static int
+worker(void *arg)
+{
+	unsigned seen = 0;
+	(void)arg;
+
+	for (;;) {
+		SDL_LockMutex(pool.lock);
+		while (!pool.quit && pool.generation == seen) {
+			SDL_CondWait(pool.wake, pool.lock);
+		}
+		if (pool.quit) {
+			SDL_UnlockMutex(pool.lock);
+			break;
+		}
+		seen = pool.generation;
+		SDL_UnlockMutex(pool.lock);
+
+		run_chunks();
+
+		SDL_LockMutex(pool.lock);
+		if (--pool.active == 0) {
+			SDL_CondSignal(pool.done);
+		}
+		SDL_UnlockMutex(pool.lock);
+	}
+
+	return 0;
+}
+
+int
+job_init(unsigned worker_count)
+{
+	if (worker_count == 0) {
+		int cpus = SDL_GetCPUCount();
+		worker_count = cpus > 1 ? cpus - 1 : 0;
+	}
+	if (worker_count > JOB_MAX_WORKERS) {
+		worker_count = JOB_MAX_WORKERS;
+	}
+
+	pool.lock = SDL_CreateMutex();
+	pool.submit_lock = SDL_CreateMutex();
+	pool.wake = SDL_CreateCond();
+	pool.done = SDL_CreateCond();
+	if (!pool.lock || !pool.submit_lock || !pool.wake || !pool.done) {
+		job_shutdown();
+		return 0;
+	}
+
+	for (unsigned i = 0; i < worker_count; i++) {
+		pool.threads[i] = SDL_CreateThread(worker, "job-worker", NULL);
+		if (!pool.threads[i]) {
+			job_shutdown();
+			return 0;
+		}
+		pool.count++;
+	}
+
+	return 1;
+}
+
+void
+job_shutdown(void)
+{
+	if (pool.lock) {
+		SDL_LockMutex(pool.lock);
+		pool.quit = 1;
+		SDL_CondBroadcast(pool.wake);
+		SDL_UnlockMutex(pool.lock);
+	}
+
+	for (unsigned i = 0; i < pool.count; i++) {
+		SDL_WaitThread(pool.threads[i], NULL);
+		pool.threads[i] = NULL;
+	}
+	pool.count = 0;
+
+	if (pool.done) {
+		SDL_DestroyCond(pool.done);
+	}
+	if (pool.wake) {
+		SDL_DestroyCond(pool.wake);
+	}
+	if (pool.submit_lock) {
+		SDL_DestroyMutex(pool.submit_lock);
+	}
+	if (pool.lock) {
+		SDL_DestroyMutex(pool.lock);
+	}
+	pool.done = pool.wake = NULL;
+	pool.lock = pool.submit_lock = NULL;
+	pool.quit = 0;
+}
+
+unsigned
+job_thread_count(void)
+{
+	return pool.count + 1;
+}
+
+void
+job_parallel_for(unsigned count, unsigned grain, JobFunc fn, void *data)
+{
+	if (grain == 0) {
+		grain = 1;
+	}
+
+	// not worth waking up the workers
+	if (pool.count == 0 || count <= grain) {
+		if (count > 0) {
+			fn(data, 0, count);
+		}
+		return;
+	}
+
+	SDL_LockMutex(pool.submit_lock);
+
+	SDL_LockMutex(pool.lock);
+	pool.fn = fn;
+	pool.data = data;
+	pool.total = count;
+	pool.grain = grain;
+	SDL_AtomicSet(&pool.next, 0);
+	pool.active = pool.count;
+	pool.generation++;
+	SDL_CondBroadcast(pool.wake);
+	SDL_UnlockMutex(pool.lock);
+
+	run_chunks();
+
+	SDL_LockMutex(pool.lock);
+	while (pool.active > 0) {
+		SDL_CondWait(pool.done, pool.lock);
+	}
+	SDL_UnlockMutex(pool.lock);
+
+	SDL_UnlockMutex(pool.submit_lock);
+}
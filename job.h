@@ -0,0 +1,37 @@
+#pragma once
+
+/*******************************************************************************
+ * Worker thread pool with a data-parallel for-each primitive.
+*******************************************************************************/
+
+#define JOB_MAX_WORKERS 32
+
+/**
+ * JobFunc - Function processing the range [begin, end) of a parallel job.
+ */
+typedef void (*JobFunc)(void *data, unsigned begin, unsigned end);
+
+/**
+ * Start the worker pool.
+ *
+ * When `worker_count` is 0, one worker per available CPU core (minus the
+ * calling thread) is started. Returns 1 on success, 0 on failure.
+ */
+int
+job_init(unsigned worker_count);
+
+void
+job_shutdown(void);
+
+/**
+ * Number of threads taking part in a parallel job, calling thread included.
+ */
+unsigned
+job_thread_count(void);
+
+/**
+ * Split [0, count) into chunks of `grain` items and process them on the
+ * worker threads and on the calling thread. Returns when all chunks are done.
+ */
+void
+job_parallel_for(unsigned count, unsigned grain, JobFunc fn, void *data);
@@ -1,10 +1,26 @@
+#include "camera.h"
+#include "cmdbuf.h"
+#include "cmdbuf_gl.h"
+#include "job.h"
+#include "mem.h"
+#include "pacing.h"
+#include "post.h"
+#include "post_gl.h"
+#include "profile.h"
+#include "shader.h"
+#include "sim.h"
 #include <GL/glew.h>
 #include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define WIDTH 800
 #define HEIGHT 600
+#define FRAME_ARENA_SIZE (4 << 20)
+#define MIN_RENDER_SCALE 0.5f
+#define GPU_BUDGET 14.0
+#define CUBE_VERTICES 36
 
 static void
 shutdown(SDL_Window *win, SDL_GLContext *ctx)
@@ -17,6 +33,9 @@ shutdown(SDL_Window *win, SDL_GLContext *ctx)
 		SDL_DestroyWindow(win);
 	}
 
+	job_shutdown();
+	mem_shutdown();
+	prof_shutdown();
 	SDL_Quit();
 }
 
@@ -66,31 +85,279 @@ init(unsigned width, unsigned height, SDL_Window **win, SDL_GLContext **ctx)
 	printf("GLSL version: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 	printf("GLEW version: %s\n", glewGetString(GLEW_VERSION));
 
+	// start profiler, allocators and worker threads
+	if (!prof_init() || !mem_init(FRAME_ARENA_SIZE) || !job_init(0)) {
+		shutdown(*win, *ctx);
+		return 0;
+	}
+
 	// one-time OpenGL state machine initializations
 	glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 
 	return 1;
 }
 
+// unit cube, without vertex buffers: the corner of every vertex is given by
+// the bits of its index in `corners`, faces are flat shaded
+static const char *scene_vs =
+	"#version 330 core\n"
+	"uniform mat4 projection;\n"
+	"uniform mat4 model_view;\n"
+	"const int corners[36] = int[36](\n"
+	"	0, 2, 1, 1, 2, 3,  4, 5, 6, 6, 5, 7,\n"
+	"	0, 4, 2, 2, 4, 6,  1, 3, 5, 5, 3, 7,\n"
+	"	0, 1, 4, 4, 1, 5,  2, 6, 3, 3, 6, 7);\n"
+	"const vec3 normals[6] = vec3[6](\n"
+	"	vec3(0, 0, -1), vec3(0, 0, 1), vec3(-1, 0, 0),\n"
+	"	vec3(1, 0, 0), vec3(0, -1, 0), vec3(0, 1, 0));\n"
+	"flat out vec3 normal;\n"
+	"void main() {\n"
+	"	int c = corners[gl_VertexID];\n"
+	"	vec3 p = vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1) - 0.5;\n"
+	"	normal = mat3(model_view) * normals[gl_VertexID / 6];\n"
+	"	gl_Position = projection * model_view * vec4(p, 1.0);\n"
+	"}\n";
+
+// lit from the camera
+static const char *scene_fs =
+	"#version 330 core\n"
+	"flat in vec3 normal;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	float light = max(normalize(normal).z, 0.0);\n"
+	"	color = vec4(vec3(0.2 + 0.7 * light), 1.0);\n"
+	"}\n";
+
+/**
+ * Renderer - Frame recording and the render target graph drawing it.
+ *
+ * The scene is drawn at a resolution scaled to keep the GPU time within
+ * budget, then upscaled to the window. Objects are drawn relative to the
+ * camera, from transforms interpolated in double precision.
+ */
+typedef struct Renderer {
+	CmdBuffer cmds;
+	FILE *trace;
+	FILE *capture;
+	PostGraph graph;
+	PostGL post;
+	PostScaler scaler;
+	unsigned scene_color;
+
+	// scene drawing
+	Camera camera;
+	Mat view;
+	Mat projection;
+	GLuint program;
+	GLuint vao;
+	GLint projection_loc;
+	GLint model_view_loc;
+} Renderer;
+
+static void
+scene_pass(void *data, const PostContext *ctx)
+{
+	(void)ctx;
+	cmd_gl_replay(data);
+}
+
 static void
-render(void)
+renderer_free(Renderer *r)
+{
+	if (r->trace) {
+		fclose(r->trace);
+	}
+	if (r->capture) {
+		fclose(r->capture);
+	}
+	glDeleteVertexArrays(1, &r->vao);
+	glDeleteProgram(r->program);
+	post_gl_free(&r->post);
+	cmd_free(&r->cmds);
+}
+
+static int
+renderer_init(Renderer *r, double gpu_budget, const char *trace_path, const char *capture_path)
 {
-	// clear color and depth buffers
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	memset(r, 0, sizeof(Renderer));
+	cmd_init(&r->cmds);
+	if (trace_path && !(r->trace = fopen(trace_path, "w"))) {
+		fprintf(stderr, "failed to open %s\n", trace_path);
+		return 0;
+	}
+	if (capture_path && !(r->capture = fopen(capture_path, "wb"))) {
+		fprintf(stderr, "failed to open %s\n", capture_path);
+		return 0;
+	}
+	if (!post_gl_init(&r->post)) {
+		return 0;
+	}
+
+	r->program = shader_program(scene_vs, scene_fs);
+	if (!r->program) {
+		return 0;
+	}
+	r->projection_loc = glGetUniformLocation(r->program, "projection");
+	r->model_view_loc = glGetUniformLocation(r->program, "model_view");
+	glGenVertexArrays(1, &r->vao);
+
+	r->camera.eye = dvec(0, 0, 0, 1);
+	r->camera.target = dvec(0, 0, -1, 1);
+	r->camera.up = dvec(0, 1, 0, 0);
+	camera_view(&r->camera, &r->view);
+	mat_persp(&r->projection, 60.0f, (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+
+	post_init(&r->graph, WIDTH, HEIGHT, 1.0f);
+	r->scene_color = post_target(&r->graph, "scene color", POST_RGBA8, POST_RENDER, 1.0f);
+	unsigned scene_depth = post_target(&r->graph, "scene depth", POST_DEPTH24, POST_RENDER, 1.0f);
+	post_pass(&r->graph, "scene pass", scene_pass, &r->cmds, r->scene_color, scene_depth);
+	unsigned upscale = post_pass(&r->graph, "upscale pass", post_gl_upscale, &r->post, POST_BACKBUFFER, POST_NONE);
+	post_read(&r->graph, upscale, r->scene_color);
+
+	// the viewport is recorded, so traces and captures are only comparable
+	// between runs at a fixed render scale; the model-view matrices as well,
+	// so frames only match when they draw the same simulation states
+	if (r->trace || r->capture) {
+		gpu_budget = 0;
+	}
+	post_scaler_init(&r->scaler, gpu_budget, MIN_RENDER_SCALE, 1.0f);
+	return post_compile(&r->graph);
+}
+
+static void
+render(const Frame *frame, Renderer *r)
+{
+	// the renderer runs one simulation step behind, so that there is always
+	// a pair of states to interpolate between
+	double alpha = (prof_now() - frame->time) / frame->step;
+	alpha = alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha);
+
+	// interpolate the world transforms in double precision, then convert
+	// them to single precision relative to the camera
+	unsigned count = frame->object_count;
+	DMat *world = arena_alloc(mem_frame(), count * sizeof(DMat), MEM_ALIGN_CACHE);
+	Mat *model_view = arena_alloc(mem_frame(), count * sizeof(Mat), MEM_ALIGN_CACHE);
+	if (!world || !model_view) {
+		fprintf(stderr, "frame arena full, skipping the scene\n");
+		count = 0;
+	}
+	for (unsigned i = 0; i < count; i++) {
+		frame_object_transform(&frame->objects[i], alpha, &world[i]);
+	}
+	camera_model_view_batch(&r->camera, &r->view, world, model_view, count);
+
+	// pick the render resolution from the GPU time of the last measured frame
+	float scale = post_scaler_update(&r->scaler, r->post.gpu_time);
+	unsigned width, height;
+	post_target_size(&r->graph, r->scene_color, scale, &width, &height);
+
+	// record the scene, then replay it on this thread as part of the graph
+	cmd_reset(&r->cmds);
+	cmd_viewport(&r->cmds, 0, 0, width, height);
+	cmd_clear(&r->cmds, CMD_CLEAR_COLOR | CMD_CLEAR_DEPTH, 0.3f, 0.3f, 0.3f, 1.0f, 1.0f);
+	cmd_state(&r->cmds, CMD_DEPTH_TEST | CMD_DEPTH_WRITE | CMD_CULL_BACK);
+	cmd_program(&r->cmds, r->program);
+	cmd_vertex_array(&r->cmds, r->vao);
+	cmd_uniform_mat4(&r->cmds, r->projection_loc, &r->projection, 1);
+	for (unsigned i = 0; i < count; i++) {
+		cmd_uniform_mat4(&r->cmds, r->model_view_loc, &model_view[i], 1);
+		cmd_draw(&r->cmds, CMD_TRIANGLES, 0, CUBE_VERTICES, 1);
+	}
+
+	post_gl_execute(&r->post, &r->graph, scale);
+	prof_count("commands", r->cmds.count);
+
+	if (r->trace) {
+		fputs("frame\n", r->trace);
+		cmd_write_trace(&r->cmds, r->trace);
+	}
+
+	// only the first frame is captured, for cmdtool
+	if (r->capture) {
+		if (!cmd_save(&r->cmds, r->capture)) {
+			fprintf(stderr, "failed to capture the frame commands\n");
+		}
+		fclose(r->capture);
+		r->capture = NULL;
+	}
 }
 
 int
 main(int argc, char *argv[])
 {
+	PresentMode mode = PRESENT_VSYNC;
+	double fps = 0;
+	double gpu_budget = GPU_BUDGET;
+	const char *trace_path = NULL;
+	const char *capture_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		int ok = 1;
+		if (strncmp(argv[i], "--present=", 10) == 0) {
+			ok = present_mode_parse(argv[i] + 10, &mode);
+		} else if (strncmp(argv[i], "--fps=", 6) == 0) {
+			fps = atof(argv[i] + 6);
+		} else if (strncmp(argv[i], "--gpu-budget=", 13) == 0) {
+			gpu_budget = atof(argv[i] + 13);
+		} else if (strncmp(argv[i], "--trace=", 8) == 0) {
+			trace_path = argv[i] + 8;
+		} else if (strncmp(argv[i], "--capture=", 10) == 0) {
+			capture_path = argv[i] + 10;
+		} else {
+			ok = 0;
+		}
+		if (!ok) {
+			fprintf(stderr, "usage: %s [--present=vsync|adaptive|uncapped|lowlatency] [--fps=N] [--gpu-budget=MS] [--trace=FILE] [--capture=FILE]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
 	SDL_Window *win = NULL;
 	SDL_GLContext *ctx = NULL;
 	if (!init(WIDTH, HEIGHT, &win, &ctx)) {
 		return EXIT_FAILURE;
 	}
 
+	// adaptive vsync is an extension, fall back to plain vsync without it
+	Pacer pacer;
+	if (!pacer_init(&pacer, mode, fps)) {
+		if (mode != PRESENT_ADAPTIVE || !pacer_init(&pacer, PRESENT_VSYNC, fps)) {
+			shutdown(win, ctx);
+			return EXIT_FAILURE;
+		}
+	}
+	printf("Presentation mode: %s\n", present_mode_name(pacer.mode));
+
+	// the simulation runs on its own thread and hands frame snapshots over
+	// to this one, which owns the GL context
+	FrameExchange *exchange = frame_exchange_new();
+	Sim *sim = exchange ? sim_start(exchange, SIM_STEP) : NULL;
+	if (!sim) {
+		frame_exchange_free(exchange);
+		pacer_free(&pacer);
+		shutdown(win, ctx);
+		return EXIT_FAILURE;
+	}
+
+	// frames are recorded into a command buffer, and also written out as
+	// text when tracing, the first one in binary form when capturing; a
+	// budget of 0 disables resolution scaling, as do tracing and capturing
+	Renderer renderer;
+	if (!renderer_init(&renderer, gpu_budget * 1e-3, trace_path, capture_path)) {
+		renderer_free(&renderer);
+		sim_stop(sim);
+		frame_exchange_free(exchange);
+		pacer_free(&pacer);
+		shutdown(win, ctx);
+		return EXIT_FAILURE;
+	}
+
 	int run = 1;
+	double last_input = 0;
 	SDL_Event evt;
 	while (run) {
+		pacer_wait(&pacer);
+		double frame_start = prof_now();
+
 		while (SDL_PollEvent(&evt)) {
 			// quit on app close event or 'esc' key press
 			if (evt.type == SDL_QUIT || (
@@ -99,12 +366,38 @@ main(int argc, char *argv[])
 				run = 0;
 				break;
 			}
+			// date events from their SDL timestamp, so that the time
+			// they waited in the queue counts as latency
+			double age = (SDL_GetTicks() - evt.common.timestamp) * 1e-3;
+			input_push(&sim->input, &evt, prof_now() - age);
 		}
 
-		render();
-		SDL_GL_SwapWindow(win);
+		// the simulation applies the input at its next step, so it only
+		// shows in a later snapshot, which carries the time of the newest
+		// event applied
+		const Frame *frame = frame_latest(exchange);
+		double input_time = frame->input_time > last_input ? frame->input_time : 0;
+		render(frame, &renderer);
+		prof_time("render", prof_now() - frame_start);
+		pacer_present(&pacer, win, input_time);
+
+		// input-to-present latency of the newest input which made it into
+		// the presented frame, until the swap; the pacer measures it until
+		// the GPU finished the frame
+		double now = prof_now();
+		if (input_time > 0) {
+			prof_time("input to present", now - input_time);
+			last_input = input_time;
+		}
+		prof_time("frame", now - frame_start);
+		mem_frame_end();
+		prof_frame_end(stdout);
 	}
 
+	renderer_free(&renderer);
+	sim_stop(sim);
+	frame_exchange_free(exchange);
+	pacer_free(&pacer);
 	shutdown(win, ctx);
 	return EXIT_SUCCESS;
 }
@@ -6,185 +6,68 @@
 # define M_PI 3.14159265358979323846
 #endif
 
-typedef struct Vec Vec;
-typedef struct Mat Mat;
-typedef struct Qtr Qtr;
-
 
 /*******************************************************************************
- * Matrix type and matrix operations.
+ * Single-precision types and operations: Mat, Vec, Qtr, mat_*(), vec_*(),
+ * qtr_*().
 *******************************************************************************/
 
-/**
- * Mat - 4x4 matrix.
- */
-struct Mat {
-	float data[16];
-};
-
-void
-mat_mul(const Mat *a, const Mat *b, Mat *r_m);
-
-void
-mat_imul(Mat *m, const Mat *other);
-
-void
-mat_mulv(const Mat *m, const Vec *v, Vec *r_v);
-
-void
-mat_rotate(Mat *m, float x, float y, float z, float angle);
-
-void
-mat_rotatev(Mat *m, const Vec *v, float angle);
-
-void
-mat_rotateq(Mat *m, const Qtr *q);
-
-Qtr
-mat_get_rotation(const Mat *m);
-
-void
-mat_scale(Mat *m, float sx, float sy, float sz);
-
-void
-mat_scalev(Mat *m, const Vec *sv);
-
-Vec
-mat_get_scale(const Mat *m);
+#define ML_REAL float
+#define ML_MAT Mat
+#define ML_VEC Vec
+#define ML_QTR Qtr
+#define ML_FN(name) name
+#include "matlib_tmpl.h"
+#undef ML_REAL
+#undef ML_MAT
+#undef ML_VEC
+#undef ML_QTR
+#undef ML_FN
 
-void
-mat_translate(Mat *m, float tx, float ty, float tz);
-
-void
-mat_translatev(Mat *m, const Vec *tv);
-
-Vec
-mat_get_translation(const Mat *m);
-
-void
-mat_lookat(
-	Mat *m,
-	float eye_x, float eye_y, float eye_z,
-	float center_x, float center_y, float center_z,
-	float up_x, float up_y, float up_z
-);
-
-void
-mat_lookatv(Mat *m, const Vec *eye, const Vec *center, const Vec *up);
-
-void
-mat_ortho(Mat *m, float l, float r, float t, float b, float n, float f);
-
-void
-mat_persp(Mat *m, float fovy, float aspect, float n, float f);
-
-void
-mat_ident(Mat *m);
-
-int
-mat_inverse(Mat *m, Mat *out_m);
-
-void
-mat_transpose(Mat *m, Mat *out_m);
 
 /*******************************************************************************
- * Vector type and vector operations.
+ * Double-precision types and operations: DMat, DVec, DQtr, dmat_*(), dvec_*(),
+ * dqtr_*().
+ *
+ * Used for composing transforms of large worlds, which then are converted to
+ * single precision relative to the camera before they reach the GPU.
 *******************************************************************************/
 
-/**
- * Vec - 4D vector.
- */
-struct Vec {
-	float data[4];
-};
+#define ML_REAL double
+#define ML_MAT DMat
+#define ML_VEC DVec
+#define ML_QTR DQtr
+#define ML_FN(name) d##name
+#include "matlib_tmpl.h"
+#undef ML_REAL
+#undef ML_MAT
+#undef ML_VEC
+#undef ML_QTR
+#undef ML_FN
 
-Vec
-vec(float x, float y, float z, float w);
-
-void
-vec_mulf(const Vec *v, float scalar, Vec *r_v);
-
-void
-vec_imulf(Vec *v, float scalar);
-
-void
-vec_add(const Vec *a, const Vec *b, Vec *r_v);
-
-void
-vec_iadd(Vec *v, const Vec *other);
-
-void
-vec_addf(const Vec *v, float scalar, Vec *r_v);
-
-void
-vec_iaddf(Vec *v, float scalar);
-
-void
-vec_sub(const Vec *a, const Vec *b, Vec *r_v);
-
-void
-vec_isub(Vec *v, const Vec *b);
-
-void
-vec_subf(const Vec *v, float scalar, Vec *r_v);
-
-void
-vec_isubf(Vec *v, float scalar);
-
-float
-vec_dot(const Vec *a, const Vec *b);
-
-float
-vec_mag(const Vec *v);
-
-void
-vec_cross(const Vec *a, const Vec *b, Vec *r_v);
-
-void
-vec_norm(Vec *v);
-
-void
-vec_clamp(Vec *v, float value);
-
-void
-vec_lerp(const Vec *a, const Vec *b, float t, Vec *r_v);
 
 /*******************************************************************************
- * Quaternion type and quaternion operations
+ * Precision conversions.
 *******************************************************************************/
-struct Qtr {
-	float data[4];
-};
-
-Qtr
-qtr(float w, float x, float y, float z);
-
-void
-qtr_rotate(Qtr *q, float x, float y, float z, float angle);
 
 void
-qtr_rotatev(Qtr *q, const Vec *axis, float angle);
+dmat_to_mat(const DMat *m, Mat *r_m);
 
 void
-qtr_add(const Qtr *a, const Qtr *b, Qtr *r_q);
+dvec_to_vec(const DVec *v, Vec *r_v);
 
 void
-qtr_iadd(Qtr *q, const Qtr *other);
+dqtr_to_qtr(const DQtr *q, Qtr *r_q);
 
 void
-qtr_mul(const Qtr *a, const Qtr *b, Qtr *r_q);
-
-void
-qtr_imul(Qtr *q, const Qtr *other);
-
-void
-qtr_mulf(const Qtr *a, float scalar, Qtr *r_q);
-
-void
-qtr_imulf(Qtr *q, float scalar);
-
-void
-qtr_norm(Qtr *a);
+qtr_to_dqtr(const Qtr *q, DQtr *r_q);
 
+/**
+ * Convert a world transform to single precision relative to `origin`.
+ *
+ * The translation is made relative in double precision, so the result keeps
+ * full float accuracy near the origin regardless of how far it is from the
+ * world center.
+ */
 void
-qtr_lerp(const Qtr *a, const Qtr *b, float t, Qtr *r_q);
+dmat_relative(const DMat *m, const DVec *origin, Mat *r_m);
@@ -0,0 +1,683 @@
+/*
+ * Matrix, vector and quaternion operations, generic over the scalar type.
+ *
+ * Included by matlib.c once per precision, see matlib_tmpl.h.
+ */
+
+void
+ML_FN(mat_mul)(const ML_MAT *a, const ML_MAT *b, ML_MAT *r)
+{
+	memset(r, 0, sizeof(ML_MAT));
+	ML_GEMM(
+		CblasRowMajor,  // row-major order
+		CblasNoTrans,   // don't transpose the first matrix
+		CblasNoTrans,   // ... neither the second
+		4, 4, 4,        // M, N, K sizes
+		1,              // scalar to multiply first
+		a->data,        // first matrix
+		4,              // stride of the first matrix
+		b->data,        // second matrix
+		4,              // stride
+		1,              // scalar to multiply the result by
+		r->data,        // result matrix pointer
+		4               // stride of result matrix
+	);
+}
+
+void
+ML_FN(mat_imul)(ML_MAT *m, const ML_MAT *other)
+{
+	ML_MAT tmp;
+	ML_FN(mat_mul)(m, other, &tmp);
+	*m = tmp;
+}
+
+void
+ML_FN(mat_mulv)(const ML_MAT *m, const ML_VEC *v, ML_VEC *r_v)
+{
+	memset(r_v, 0, sizeof(ML_VEC));
+	ML_GEMV(
+		CblasRowMajor,  // row-major order
+		CblasNoTrans,   // do not transpose the matrix
+		4, 4,           // M and N dimensions
+		1,              // scalar to premultiply
+		m->data,        // matrix data
+		4,              // matrix stride
+		v->data,        // vector data
+		1,              // vector inter-element increment
+		1,              // scalar to postmultiply
+		r_v->data,      // result buffer
+		1               // result buffer inter-element increment
+	);
+}
+
+void
+ML_FN(mat_rotate)(ML_MAT *m, ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL angle)
+{
+	ML_VEC v = {{x, y, z}};
+	ML_FN(mat_rotatev)(m, &v, angle);
+}
+
+void
+ML_FN(mat_rotatev)(ML_MAT *m, const ML_VEC *v, ML_REAL angle)
+{
+	ML_MAT rm, tmp;
+	ML_FN(mat_ident)(&rm);
+
+	const ML_REAL x = v->data[0];
+	const ML_REAL y = v->data[1];
+	const ML_REAL z = v->data[2];
+	ML_REAL sin_a, cos_a;
+	ML_SINCOS(angle, &sin_a, &cos_a);
+	const ML_REAL k = 1 - cos_a;
+
+	rm.data[0] = cos_a + k * x * x;
+	rm.data[1] = k * x * y - z * sin_a;
+	rm.data[2] = k * x * z + y * sin_a;
+	rm.data[4] = k * x * y + z * sin_a;
+	rm.data[5] = cos_a + k * y * y;
+	rm.data[6] = k * y * z - x * sin_a;
+	rm.data[8] = k * x * z - y * sin_a;
+	rm.data[9] = k * y * z + x * sin_a;
+	rm.data[10] = cos_a + k * z * z;
+	rm.data[15] = 1.0f;
+
+	ML_FN(mat_mul)(&rm, m, &tmp);
+	memcpy(m, &tmp, sizeof(ML_MAT));
+}
+
+void
+ML_FN(mat_rotateq)(ML_MAT *m, const ML_QTR *q)
+{
+	ML_REAL w = q->data[0], x = q->data[1], y = q->data[2], z = q->data[3];
+	ML_MAT tmp, rm = {{
+		1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - z * w),       2.0 * (x * z + y * w),       0.0,
+		2.0 * (x * y + z * w),       1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - x * w),       0.0,
+		2.0 * (x * z - y * w),       2.0 * (y * z + x * w),       1.0 - 2.0 * (x * x + y * y), 0.0,
+		0.0,                         0.0,                         0.0,                         1.0
+	}};
+	ML_FN(mat_mul)(m, &rm, &tmp);
+	*m = tmp;
+}
+
+
+void
+ML_FN(mat_scale)(ML_MAT *m, ML_REAL sx, ML_REAL sy, ML_REAL sz)
+{
+	ML_MAT sm, tmp;
+	ML_FN(mat_ident)(&sm);
+	sm.data[0] = sx;
+	sm.data[5] = sy;
+	sm.data[10] = sz;
+
+	ML_FN(mat_mul)(m, &sm, &tmp);
+	*m = tmp;
+}
+
+void
+ML_FN(mat_scalev)(ML_MAT *m, const ML_VEC *sv)
+{
+	ML_FN(mat_scale)(m, sv->data[0], sv->data[1], sv->data[2]);
+}
+
+ML_VEC
+ML_FN(mat_get_scale)(const ML_MAT *m)
+{
+	ML_VEC vx = ML_FN(vec)(m->data[0], m->data[4], m->data[8], 0);
+	ML_VEC vy = ML_FN(vec)(m->data[1], m->data[5], m->data[9], 0);
+	ML_VEC vz = ML_FN(vec)(m->data[2], m->data[6], m->data[10], 0);
+	return ML_FN(vec)(ML_FN(vec_mag)(&vx), ML_FN(vec_mag)(&vy), ML_FN(vec_mag)(&vz), 0);
+}
+
+ML_VEC
+ML_FN(mat_get_translation)(const ML_MAT *m)
+{
+	ML_VEC o = ML_FN(vec)(0, 0, 0, 1);
+	ML_VEC pos, result;
+	ML_FN(mat_mulv)(m, &o, &pos);
+	ML_FN(vec_mulf)(&pos, -1.0f, &result);
+	return result;
+}
+
+ML_QTR
+ML_FN(mat_get_rotation)(const ML_MAT *m)
+{
+	const ML_REAL *mat = m->data;
+	ML_REAL t = 1 + mat[0] + mat[5] + mat[10], s, x, y, z, w;
+	if (ML_FABS(t) > (ML_REAL)0.00000001) {
+		s = ML_SQRT(t) * 2;
+		x = (mat[9] - mat[6]) / s;
+		y = (mat[2] - mat[8]) / s;
+		z = (mat[4] - mat[1]) / s;
+		w = 0.25 * s;
+	} else if (mat[0] > mat[5] && mat[0] > mat[10])  {
+		s = ML_SQRT(1.0f + mat[0] - mat[5] - mat[10]) * 2;
+		x = 0.25 * s;
+		y = (mat[4] + mat[1]) / s;
+		z = (mat[2] + mat[8]) / s;
+		w = (mat[9] - mat[6]) / s;
+	} else if (mat[5] > mat[10]) {
+		s = ML_SQRT(1.0f + mat[5] - mat[0] - mat[10]) * 2;
+		x = (mat[4] + mat[1]) / s;
+		y = 0.25 * s;
+		z = (mat[9] + mat[6]) / s;
+		w = (mat[2] - mat[8]) / s;
+	} else {
+		s = ML_SQRT(1.0f + mat[10] - mat[0] - mat[5]) * 2;
+		x = (mat[2] + mat[8]) / s;
+		y = (mat[9] + mat[6]) / s;
+		z = 0.25 * s;
+		w = (mat[4] - mat[1]) / s;
+	}
+
+	return ML_FN(qtr)(w, x, y, z);
+}
+
+void
+ML_FN(mat_translate)(ML_MAT *m, ML_REAL tx, ML_REAL ty, ML_REAL tz)
+{
+	ML_MAT tm, tmp;
+	ML_FN(mat_ident)(&tm);
+	tm.data[3] = tx;
+	tm.data[7] = ty;
+	tm.data[11] = tz;
+
+	ML_FN(mat_mul)(m, &tm, &tmp);
+	*m = tmp;
+}
+
+void
+ML_FN(mat_translatev)(ML_MAT *m, const ML_VEC *tv)
+{
+	ML_FN(mat_translate)(m, tv->data[0], tv->data[1], tv->data[2]);
+}
+
+void
+ML_FN(mat_ident)(ML_MAT *m)
+{
+	memset(m, 0, sizeof(ML_MAT));
+	m->data[0] = m->data[5] = m->data[10] = m->data[15] = 1;
+}
+
+void
+ML_FN(mat_compose)(ML_MAT *m, const ML_VEC *t, const ML_QTR *r, const ML_VEC *s)
+{
+	ML_REAL w = r->data[0], x = r->data[1], y = r->data[2], z = r->data[3];
+	ML_REAL sx = s->data[0], sy = s->data[1], sz = s->data[2];
+	ML_MAT tm = {{
+		(1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y - z * w) * sy,          2.0f * (x * z + y * w) * sz,          t->data[0],
+		2.0f * (x * y + z * w) * sx,          (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z - x * w) * sz,          t->data[1],
+		2.0f * (x * z - y * w) * sx,          2.0f * (y * z + x * w) * sy,          (1.0f - 2.0f * (x * x + y * y)) * sz, t->data[2],
+		0.0f,                                 0.0f,                                 0.0f,                                 1.0f
+	}};
+	*m = tm;
+}
+
+int
+ML_FN(mat_inverse)(ML_MAT *m, ML_MAT *out_m)
+{
+	ML_REAL inv[16], det;
+	ML_REAL *mdata = m->data;
+	ML_REAL *out_mdata = out_m->data;
+
+	inv[0] = mdata[5]  * mdata[10] * mdata[15] -
+	         mdata[5]  * mdata[11] * mdata[14] -
+	         mdata[9]  * mdata[6]  * mdata[15] +
+	         mdata[9]  * mdata[7]  * mdata[14] +
+	         mdata[13] * mdata[6]  * mdata[11] -
+	         mdata[13] * mdata[7]  * mdata[10];
+
+	inv[4] = -mdata[4]  * mdata[10] * mdata[15] +
+	         mdata[4]  * mdata[11] * mdata[14] +
+	         mdata[8]  * mdata[6]  * mdata[15] -
+	         mdata[8]  * mdata[7]  * mdata[14] -
+	         mdata[12] * mdata[6]  * mdata[11] +
+	         mdata[12] * mdata[7]  * mdata[10];
+
+	inv[8] = mdata[4]  * mdata[9] * mdata[15] -
+	         mdata[4]  * mdata[11] * mdata[13] -
+	         mdata[8]  * mdata[5] * mdata[15] +
+	         mdata[8]  * mdata[7] * mdata[13] +
+	         mdata[12] * mdata[5] * mdata[11] -
+	         mdata[12] * mdata[7] * mdata[9];
+
+	inv[12] = -mdata[4]  * mdata[9] * mdata[14] +
+	         mdata[4]  * mdata[10] * mdata[13] +
+	         mdata[8]  * mdata[5] * mdata[14] -
+	         mdata[8]  * mdata[6] * mdata[13] -
+	         mdata[12] * mdata[5] * mdata[10] +
+	         mdata[12] * mdata[6] * mdata[9];
+
+	inv[1] = -mdata[1]  * mdata[10] * mdata[15] +
+	         mdata[1]  * mdata[11] * mdata[14] +
+	         mdata[9]  * mdata[2] * mdata[15] -
+	         mdata[9]  * mdata[3] * mdata[14] -
+	         mdata[13] * mdata[2] * mdata[11] +
+	         mdata[13] * mdata[3] * mdata[10];
+
+	inv[5] = mdata[0]  * mdata[10] * mdata[15] -
+	         mdata[0]  * mdata[11] * mdata[14] -
+	         mdata[8]  * mdata[2] * mdata[15] +
+	         mdata[8]  * mdata[3] * mdata[14] +
+	         mdata[12] * mdata[2] * mdata[11] -
+	         mdata[12] * mdata[3] * mdata[10];
+
+	inv[9] = -mdata[0]  * mdata[9] * mdata[15] +
+	         mdata[0]  * mdata[11] * mdata[13] +
+	         mdata[8]  * mdata[1] * mdata[15] -
+	         mdata[8]  * mdata[3] * mdata[13] -
+	         mdata[12] * mdata[1] * mdata[11] +
+	         mdata[12] * mdata[3] * mdata[9];
+
+	inv[13] = mdata[0]  * mdata[9] * mdata[14] -
+	          mdata[0]  * mdata[10] * mdata[13] -
+	          mdata[8]  * mdata[1] * mdata[14] +
+	          mdata[8]  * mdata[2] * mdata[13] +
+	          mdata[12] * mdata[1] * mdata[10] -
+	          mdata[12] * mdata[2] * mdata[9];
+
+	inv[2] = mdata[1]  * mdata[6] * mdata[15] -
+	         mdata[1]  * mdata[7] * mdata[14] -
+	         mdata[5]  * mdata[2] * mdata[15] +
+	         mdata[5]  * mdata[3] * mdata[14] +
+	         mdata[13] * mdata[2] * mdata[7] -
+	         mdata[13] * mdata[3] * mdata[6];
+
+	inv[6] = -mdata[0]  * mdata[6] * mdata[15] +
+	         mdata[0]  * mdata[7] * mdata[14] +
+	         mdata[4]  * mdata[2] * mdata[15] -
+	         mdata[4]  * mdata[3] * mdata[14] -
+	         mdata[12] * mdata[2] * mdata[7] +
+	         mdata[12] * mdata[3] * mdata[6];
+
+	inv[10] = mdata[0]  * mdata[5] * mdata[15] -
+	          mdata[0]  * mdata[7] * mdata[13] -
+	          mdata[4]  * mdata[1] * mdata[15] +
+	          mdata[4]  * mdata[3] * mdata[13] +
+	          mdata[12] * mdata[1] * mdata[7] -
+	          mdata[12] * mdata[3] * mdata[5];
+
+	inv[14] = -mdata[0]  * mdata[5] * mdata[14] +
+	          mdata[0]  * mdata[6] * mdata[13] +
+	          mdata[4]  * mdata[1] * mdata[14] -
+	          mdata[4]  * mdata[2] * mdata[13] -
+	          mdata[12] * mdata[1] * mdata[6] +
+	          mdata[12] * mdata[2] * mdata[5];
+
+	inv[3] = -mdata[1] * mdata[6] * mdata[11] +
+	         mdata[1] * mdata[7] * mdata[10] +
+	         mdata[5] * mdata[2] * mdata[11] -
+	         mdata[5] * mdata[3] * mdata[10] -
+	         mdata[9] * mdata[2] * mdata[7] +
+	         mdata[9] * mdata[3] * mdata[6];
+
+	inv[7] = mdata[0] * mdata[6] * mdata[11] -
+	         mdata[0] * mdata[7] * mdata[10] -
+	         mdata[4] * mdata[2] * mdata[11] +
+	         mdata[4] * mdata[3] * mdata[10] +
+	         mdata[8] * mdata[2] * mdata[7] -
+	         mdata[8] * mdata[3] * mdata[6];
+
+	inv[11] = -mdata[0] * mdata[5] * mdata[11] +
+	          mdata[0] * mdata[7] * mdata[9] +
+	          mdata[4] * mdata[1] * mdata[11] -
+	          mdata[4] * mdata[3] * mdata[9] -
+	          mdata[8] * mdata[1] * mdata[7] +
+	          mdata[8] * mdata[3] * mdata[5];
+
+	inv[15] = mdata[0] * mdata[5] * mdata[10] -
+	          mdata[0] * mdata[6] * mdata[9] -
+		  mdata[4] * mdata[1] * mdata[10] +
+		  mdata[4] * mdata[2] * mdata[9] +
+		  mdata[8] * mdata[1] * mdata[6] -
+		  mdata[8] * mdata[2] * mdata[5];
+
+	det = mdata[0] * inv[0] + mdata[1] * inv[4] +
+	      mdata[2] * inv[8] + mdata[3] * inv[12];
+	if (det == 0)
+		return 0;
+
+	det = 1.0 / det;
+
+	for (int i = 0; i < 16; i++)
+		out_mdata[i] = inv[i] * det;
+
+	return 1;
+}
+
+
+void
+ML_FN(mat_transpose)(ML_MAT *m, ML_MAT *out_m)
+{
+	for (short i = 0; i < 4; i++) {
+		for (short j = 0; j < 4; j++) {
+			out_m->data[i * 4 + j] = m->data[j * 4 + i];
+		}
+	}
+}
+
+void
+ML_FN(mat_lookat)(
+	ML_MAT *m,
+	ML_REAL eye_x, ML_REAL eye_y, ML_REAL eye_z,
+	ML_REAL center_x, ML_REAL center_y, ML_REAL center_z,
+	ML_REAL up_x, ML_REAL up_y, ML_REAL up_z
+) {
+	ML_VEC eye = ML_FN(vec)(eye_x, eye_y, eye_z, 0);
+	ML_VEC center = ML_FN(vec)(center_x, center_y, center_z, 0);
+	ML_VEC up = ML_FN(vec)(up_x, up_y, up_z, 0);
+	ML_FN(mat_lookatv)(m, &eye, &center, &up);
+}
+
+void
+ML_FN(mat_lookatv)(ML_MAT *m, const ML_VEC *eye, const ML_VEC *center, const ML_VEC *up)
+{
+	ML_VEC z;
+	ML_FN(vec_sub)(center, eye, &z);
+	ML_FN(vec_norm)(&z);
+
+	ML_VEC up_norm;
+	memcpy(&up_norm, up, sizeof(ML_VEC));
+	ML_FN(vec_norm)(&up_norm);
+
+	ML_VEC x;
+	ML_FN(vec_cross)(&z, &up_norm, &x);
+	ML_FN(vec_norm)(&x);
+
+	ML_VEC y;
+	ML_FN(vec_cross)(&x, &z, &y);
+	ML_FN(vec_norm)(&y);
+
+	ML_MAT lookat = {{
+		 x.data[0],  x.data[1],  x.data[2], 0.0,
+		 y.data[0],  y.data[1],  y.data[2], 0.0,
+		-z.data[0], -z.data[1], -z.data[2], 0.0,
+		0,          0,          0,          1
+	}};
+	ML_FN(mat_translate)(&lookat, -eye->data[0], -eye->data[1], -eye->data[2]);
+	memcpy(m, &lookat, sizeof(ML_MAT));
+}
+
+void
+ML_FN(mat_ortho)(ML_MAT *m, ML_REAL l, ML_REAL r, ML_REAL t, ML_REAL b, ML_REAL n, ML_REAL f)
+{
+	ML_REAL x = 2.0f / (r - l);
+	ML_REAL y = 2.0f / (t - b);
+	ML_REAL z = -2.0f / (f - n);
+
+	ML_REAL tx = -(r + l) / (r - l);
+	ML_REAL ty = -(t + b) / (t - b);
+	ML_REAL tz = -(f + n) / (f - n);
+
+	ML_MAT ortho = {{
+		x, 0, 0, tx,
+		0, y, 0, ty,
+		0, 0, z, tz,
+		0, 0, 0, 1
+	}};
+	memcpy(m, &ortho, sizeof(ML_MAT));
+}
+
+void
+ML_FN(mat_persp)(ML_MAT *m, ML_REAL fovy, ML_REAL aspect, ML_REAL n, ML_REAL f)
+{
+	fovy = M_PI / 180.0 * fovy;
+	ML_REAL y = 1.0 / (fovy / 2.0);
+	ML_REAL x = y / aspect;
+	ML_REAL z = (f + n) / (n - f);
+	ML_REAL tz = (2 * f * n) / (n - f);
+	ML_MAT persp = {{
+		x, 0, 0, 0,
+		0, y, 0, 0,
+		0, 0, z, tz,
+		0, 0, -1, 0
+	}};
+	memcpy(m, &persp, sizeof(ML_MAT));
+}
+
+ML_VEC
+ML_FN(vec)(ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL w)
+{
+	ML_VEC v = {{ x, y, z, w }};
+	return v;
+}
+
+void
+ML_FN(vec_addf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v)
+{
+	r_v->data[0] = v->data[0] + scalar;
+	r_v->data[1] = v->data[1] + scalar;
+	r_v->data[2] = v->data[2] + scalar;
+	r_v->data[3] = v->data[3] + scalar;
+}
+
+void
+ML_FN(vec_iaddf)(ML_VEC *v, ML_REAL scalar)
+{
+	ML_FN(vec_addf)(v, scalar, v);
+}
+
+void
+ML_FN(vec_add)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v)
+{
+	r_v->data[0] = a->data[0] + b->data[0];
+	r_v->data[1] = a->data[1] + b->data[1];
+	r_v->data[2] = a->data[2] + b->data[2];
+	r_v->data[3] = a->data[3] + b->data[3];
+}
+
+void
+ML_FN(vec_iadd)(ML_VEC *v, const ML_VEC *other)
+{
+	ML_FN(vec_add)(v, other, v);
+}
+
+void
+ML_FN(vec_subf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v)
+{
+	r_v->data[0] = v->data[0] - scalar;
+	r_v->data[1] = v->data[1] - scalar;
+	r_v->data[2] = v->data[2] - scalar;
+	r_v->data[3] = v->data[3] - scalar;
+}
+
+void
+ML_FN(vec_isubf)(ML_VEC *v, ML_REAL scalar)
+{
+	ML_FN(vec_subf)(v, scalar, v);
+}
+
+void
+ML_FN(vec_sub)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v)
+{
+	r_v->data[0] = a->data[0] - b->data[0];
+	r_v->data[1] = a->data[1] - b->data[1];
+	r_v->data[2] = a->data[2] - b->data[2];
+	r_v->data[3] = a->data[3] - b->data[3];
+}
+
+void
+ML_FN(vec_isub)(ML_VEC *v, const ML_VEC *other)
+{
+	ML_FN(vec_sub)(v, other, v);
+}
+
+void
+ML_FN(vec_mulf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v)
+{
+	r_v->data[0] = v->data[0] * scalar;
+	r_v->data[1] = v->data[1] * scalar;
+	r_v->data[2] = v->data[2] * scalar;
+	r_v->data[3] = v->data[3] * scalar;
+}
+
+void
+ML_FN(vec_imulf)(ML_VEC *v, ML_REAL scalar)
+{
+	ML_FN(vec_mulf)(v, scalar, v);
+}
+
+ML_REAL
+ML_FN(vec_dot)(const ML_VEC *a, const ML_VEC *b)
+{
+	return ML_DOT(3, a->data, 1, b->data, 1);
+}
+
+ML_REAL
+ML_FN(vec_mag)(const ML_VEC *v)
+{
+	ML_REAL x = v->data[0], y = v->data[1], z = v->data[2];
+	return ML_SQRT(x * x + y * y + z * z);
+}
+
+void
+ML_FN(vec_norm)(ML_VEC *v)
+{
+	ML_REAL x = v->data[0], y = v->data[1], z = v->data[2];
+	ML_FN(vec_mulf)(v, ML_RSQRT(x * x + y * y + z * z), v);
+}
+
+void
+ML_FN(vec_clamp)(ML_VEC *v, ML_REAL value)
+{
+	if (ML_FN(vec_mag)(v) > value) {
+		ML_FN(vec_norm)(v);
+		ML_FN(vec_imulf)(v, value);
+	}
+}
+
+void
+ML_FN(vec_cross)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v)
+{
+	r_v->data[0] = a->data[1] * b->data[2] - a->data[2] * b->data[1];
+	r_v->data[1] = a->data[2] * b->data[0] - a->data[0] * b->data[2];
+	r_v->data[2] = a->data[0] * b->data[1] - a->data[1] * b->data[0];
+	r_v->data[3] = 0;  // no cross product exists for 4D vectors
+}
+
+void
+ML_FN(vec_lerp)(const ML_VEC *a, const ML_VEC *b, ML_REAL t, ML_VEC *r_v)
+{
+	ML_VEC at, bt;
+	ML_FN(vec_mulf)(a, 1 - t, &at);
+	ML_FN(vec_mulf)(b, t, &bt);
+	ML_FN(vec_add)(&at, &bt, r_v);
+}
+
+
+ML_QTR
+ML_FN(qtr)(ML_REAL w, ML_REAL x, ML_REAL y, ML_REAL z)
+{
+	ML_QTR q = {{w, x, y, z}};
+	return q;
+}
+
+void
+ML_FN(qtr_rotate)(ML_QTR *q, ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL angle)
+{
+	ML_REAL s, c;
+	ML_SINCOS(angle / 2.0f, &s, &c);
+	ML_QTR tmp, rq = {{
+		c,
+		x * s,
+		y * s,
+		z * s,
+	}};
+	ML_FN(qtr_mul)(q, &rq, &tmp);
+	*q = tmp;
+}
+
+void
+ML_FN(qtr_rotatev)(ML_QTR *q, const ML_VEC *axis, ML_REAL angle)
+{
+	ML_REAL s, c;
+	ML_SINCOS(angle / 2.0f, &s, &c);
+	ML_QTR tmp, rq = {{
+		c,
+		axis->data[0] * s,
+		axis->data[1] * s,
+		axis->data[2] * s,
+	}};
+	ML_FN(qtr_mul)(q, &rq, &tmp);
+	*q = tmp;
+}
+
+void
+ML_FN(qtr_mulf)(const ML_QTR *a, ML_REAL scalar, ML_QTR *r_q)
+{
+	r_q->data[0] = a->data[0] * scalar;
+	r_q->data[1] = a->data[1] * scalar;
+	r_q->data[2] = a->data[2] * scalar;
+	r_q->data[3] = a->data[3] * scalar;
+}
+
+void
+ML_FN(qtr_imulf)(ML_QTR *q, ML_REAL scalar)
+{
+	q->data[0] *= scalar;
+	q->data[1] *= scalar;
+	q->data[2] *= scalar;
+	q->data[3] *= scalar;
+}
+
+void
+ML_FN(qtr_mul)(const ML_QTR *a, const ML_QTR *b, ML_QTR *r_q)
+{
+	r_q->data[1] =  a->data[1] * b->data[0] + a->data[2] * b->data[3] - a->data[3] * b->data[2] + a->data[0] * b->data[1];
+	r_q->data[2] = -a->data[1] * b->data[3] + a->data[2] * b->data[0] + a->data[3] * b->data[1] + a->data[0] * b->data[2];
+	r_q->data[3] =  a->data[1] * b->data[2] - a->data[2] * b->data[1] + a->data[3] * b->data[0] + a->data[0] * b->data[3];
+	r_q->data[0] = -a->data[1] * b->data[1] - a->data[2] * b->data[2] - a->data[3] * b->data[3] + a->data[0] * b->data[0];
+}
+
+void
+ML_FN(qtr_imul)(ML_QTR *q, const ML_QTR *other)
+{
+	ML_QTR tmp;
+	ML_FN(qtr_mul)(q, other, &tmp);
+	*q = tmp;
+}
+
+void
+ML_FN(qtr_add)(const ML_QTR *a, const ML_QTR *b, ML_QTR *r_q)
+{
+	r_q->data[0] = a->data[0] + b->data[0];
+	r_q->data[1] = a->data[1] + b->data[1];
+	r_q->data[2] = a->data[2] + b->data[2];
+	r_q->data[3] = a->data[3] + b->data[3];
+}
+
+void
+ML_FN(qtr_iadd)(ML_QTR *q, const ML_QTR *other)
+{
+	q->data[0] += other->data[0];
+	q->data[1] += other->data[1];
+	q->data[2] += other->data[2];
+	q->data[3] += other->data[3];
+}
+
+ML_REAL
+ML_FN(qtr_dot)(const ML_QTR *a, const ML_QTR *b)
+{
+	return (
+		a->data[0] * b->data[0] +
+		a->data[1] * b->data[1] +
+		a->data[2] * b->data[2] +
+		a->data[3] * b->data[3]
+	);
+}
+
+void
+ML_FN(qtr_norm)(ML_QTR *q)
+{
+	ML_FN(qtr_imulf)(q, ML_RSQRT(ML_FN(qtr_dot)(q, q)));
+}
+
+void
+ML_FN(qtr_lerp)(const ML_QTR *a, const ML_QTR *b, ML_REAL t, ML_QTR *r_q)
+{
+	ML_QTR at, bt;
+	ML_FN(qtr_mulf)(a, 1 - t, &at);
+	ML_FN(qtr_mulf)(b, t, &bt);
+	ML_FN(qtr_add)(&at, &bt, r_q);
+	ML_FN(qtr_norm)(r_q);
+}
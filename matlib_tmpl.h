@@ -0,0 +1,206 @@
+/*
+ * Matrix, vector and quaternion declarations, generic over the scalar type.
+ *
+ * Included by matlib.h once per precision with the following defined:
+ *   ML_REAL  scalar type
+ *   ML_MAT   matrix type name
+ *   ML_VEC   vector type name
+ *   ML_QTR   quaternion type name
+ *   ML_FN    function name decorator
+ */
+
+typedef struct ML_MAT ML_MAT;
+typedef struct ML_VEC ML_VEC;
+typedef struct ML_QTR ML_QTR;
+
+
+/*******************************************************************************
+ * Matrix type and matrix operations.
+*******************************************************************************/
+
+/**
+ * Mat, DMat - 4x4 matrix.
+ */
+struct ML_MAT {
+	ML_REAL data[16];
+};
+
+void
+ML_FN(mat_mul)(const ML_MAT *a, const ML_MAT *b, ML_MAT *r_m);
+
+void
+ML_FN(mat_imul)(ML_MAT *m, const ML_MAT *other);
+
+void
+ML_FN(mat_mulv)(const ML_MAT *m, const ML_VEC *v, ML_VEC *r_v);
+
+void
+ML_FN(mat_rotate)(ML_MAT *m, ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL angle);
+
+void
+ML_FN(mat_rotatev)(ML_MAT *m, const ML_VEC *v, ML_REAL angle);
+
+void
+ML_FN(mat_rotateq)(ML_MAT *m, const ML_QTR *q);
+
+ML_QTR
+ML_FN(mat_get_rotation)(const ML_MAT *m);
+
+void
+ML_FN(mat_scale)(ML_MAT *m, ML_REAL sx, ML_REAL sy, ML_REAL sz);
+
+void
+ML_FN(mat_scalev)(ML_MAT *m, const ML_VEC *sv);
+
+ML_VEC
+ML_FN(mat_get_scale)(const ML_MAT *m);
+
+void
+ML_FN(mat_translate)(ML_MAT *m, ML_REAL tx, ML_REAL ty, ML_REAL tz);
+
+void
+ML_FN(mat_translatev)(ML_MAT *m, const ML_VEC *tv);
+
+ML_VEC
+ML_FN(mat_get_translation)(const ML_MAT *m);
+
+void
+ML_FN(mat_lookat)(
+	ML_MAT *m,
+	ML_REAL eye_x, ML_REAL eye_y, ML_REAL eye_z,
+	ML_REAL center_x, ML_REAL center_y, ML_REAL center_z,
+	ML_REAL up_x, ML_REAL up_y, ML_REAL up_z
+);
+
+void
+ML_FN(mat_lookatv)(ML_MAT *m, const ML_VEC *eye, const ML_VEC *center, const ML_VEC *up);
+
+void
+ML_FN(mat_ortho)(ML_MAT *m, ML_REAL l, ML_REAL r, ML_REAL t, ML_REAL b, ML_REAL n, ML_REAL f);
+
+void
+ML_FN(mat_persp)(ML_MAT *m, ML_REAL fovy, ML_REAL aspect, ML_REAL n, ML_REAL f);
+
+void
+ML_FN(mat_ident)(ML_MAT *m);
+
+/**
+ * Build a transform from translation, rotation and scale (T * R * S).
+ */
+void
+ML_FN(mat_compose)(ML_MAT *m, const ML_VEC *t, const ML_QTR *r, const ML_VEC *s);
+
+int
+ML_FN(mat_inverse)(ML_MAT *m, ML_MAT *out_m);
+
+void
+ML_FN(mat_transpose)(ML_MAT *m, ML_MAT *out_m);
+
+/*******************************************************************************
+ * Vector type and vector operations.
+*******************************************************************************/
+
+/**
+ * Vec, DVec - 4D vector.
+ */
+struct ML_VEC {
+	ML_REAL data[4];
+};
+
+ML_VEC
+ML_FN(vec)(ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL w);
+
+void
+ML_FN(vec_mulf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v);
+
+void
+ML_FN(vec_imulf)(ML_VEC *v, ML_REAL scalar);
+
+void
+ML_FN(vec_add)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v);
+
+void
+ML_FN(vec_iadd)(ML_VEC *v, const ML_VEC *other);
+
+void
+ML_FN(vec_addf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v);
+
+void
+ML_FN(vec_iaddf)(ML_VEC *v, ML_REAL scalar);
+
+void
+ML_FN(vec_sub)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v);
+
+void
+ML_FN(vec_isub)(ML_VEC *v, const ML_VEC *b);
+
+void
+ML_FN(vec_subf)(const ML_VEC *v, ML_REAL scalar, ML_VEC *r_v);
+
+void
+ML_FN(vec_isubf)(ML_VEC *v, ML_REAL scalar);
+
+ML_REAL
+ML_FN(vec_dot)(const ML_VEC *a, const ML_VEC *b);
+
+ML_REAL
+ML_FN(vec_mag)(const ML_VEC *v);
+
+void
+ML_FN(vec_cross)(const ML_VEC *a, const ML_VEC *b, ML_VEC *r_v);
+
+void
+ML_FN(vec_norm)(ML_VEC *v);
+
+void
+ML_FN(vec_clamp)(ML_VEC *v, ML_REAL value);
+
+void
+ML_FN(vec_lerp)(const ML_VEC *a, const ML_VEC *b, ML_REAL t, ML_VEC *r_v);
+
+/*******************************************************************************
+ * Quaternion type and quaternion operations
+*******************************************************************************/
+
+/**
+ * Qtr, DQtr - Quaternion, stored as (w, x, y, z).
+ */
+struct ML_QTR {
+	ML_REAL data[4];
+};
+
+ML_QTR
+ML_FN(qtr)(ML_REAL w, ML_REAL x, ML_REAL y, ML_REAL z);
+
+void
+ML_FN(qtr_rotate)(ML_QTR *q, ML_REAL x, ML_REAL y, ML_REAL z, ML_REAL angle);
+
+void
+ML_FN(qtr_rotatev)(ML_QTR *q, const ML_VEC *axis, ML_REAL angle);
+
+void
+ML_FN(qtr_add)(const ML_QTR *a, const ML_QTR *b, ML_QTR *r_q);
+
+void
+ML_FN(qtr_iadd)(ML_QTR *q, const ML_QTR *other);
+
+void
+ML_FN(qtr_mul)(const ML_QTR *a, const ML_QTR *b, ML_QTR *r_q);
+
+void
+ML_FN(qtr_imul)(ML_QTR *q, const ML_QTR *other);
+
+void
+ML_FN(qtr_mulf)(const ML_QTR *a, ML_REAL scalar, ML_QTR *r_q);
+
+void
+ML_FN(qtr_imulf)(ML_QTR *q, ML_REAL scalar);
+
+ML_REAL
+ML_FN(qtr_dot)(const ML_QTR *a, const ML_QTR *b);
+
+void
+ML_FN(qtr_norm)(ML_QTR *a);
+
+void
+ML_FN(qtr_lerp)(const ML_QTR *a, const ML_QTR *b, ML_REAL t, ML_QTR *r_q);
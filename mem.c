@@ -0,0 +1,298 @@
+#include "mem.h"
+#include "profile.h"
+#include <SDL.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_REGISTERED 128
+
+static const char *tag_names[MEM_TAG_COUNT][3] = {
+	{ "mem frame bytes", "mem frame peak", "mem frame allocs" },
+	{ "mem jobs bytes", "mem jobs peak", "mem jobs allocs" },
+	{ "mem scene bytes", "mem scene peak", "mem scene allocs" },
+	{ "mem mesh bytes", "mem mesh peak", "mem mesh allocs" },
+};
+
+static struct {
+	SDL_mutex *lock;
+	SDL_TLSID tls;
+	Arena frames[2];
+	unsigned current;
+
+	// every live arena and pool, for reporting
+	MemStats *registered[MAX_REGISTERED];
+	unsigned count;
+	unsigned long reported_allocs[MEM_TAG_COUNT];
+} mem;
+
+static void
+track(MemStats *stats)
+{
+	if (!mem.lock) {
+		return;
+	}
+	SDL_LockMutex(mem.lock);
+	if (mem.count < MAX_REGISTERED) {
+		mem.registered[mem.count++] = stats;
+	}
+	SDL_UnlockMutex(mem.lock);
+}
+
+static void
+untrack(MemStats *stats)
+{
+	if (!mem.lock) {
+		return;
+	}
+	SDL_LockMutex(mem.lock);
+	for (unsigned i = 0; i < mem.count; i++) {
+		if (mem.registered[i] == stats) {
+			mem.registered[i] = mem.registered[--mem.count];
+			break;
+		}
+	}
+	SDL_UnlockMutex(mem.lock);
+}
+
+static void*
+alloc_aligned(size_t size, size_t align, void **r_block)
+{
+	*r_block = malloc(size + align - 1);
+	if (!*r_block) {
+		return NULL;
+	}
+	uintptr_t p = ((uintptr_t)*r_block + align - 1) & ~(uintptr_t)(align - 1);
+	return (void*)p;
+}
+
+int
+arena_init(Arena *arena, size_t size, MemTag tag)
+{
+	memset(arena, 0, sizeof(Arena));
+	arena->base = alloc_aligned(size, MEM_ALIGN_CACHE, &arena->block);
+	if (!arena->base) {
+		return 0;
+	}
+	arena->size = size;
+	arena->stats.tag = tag;
+	track(&arena->stats);
+	return 1;
+}
+
+void
+arena_free(Arena *arena)
+{
+	if (arena->block) {
+		untrack(&arena->stats);
+		free(arena->block);
+	}
+	memset(arena, 0, sizeof(Arena));
+}
+
+void*
+arena_alloc(Arena *arena, size_t size, size_t align)
+{
+	size_t offset = (arena->stats.used + align - 1) & ~(align - 1);
+	if (offset + size > arena->size) {
+		return NULL;
+	}
+	arena->stats.used = offset + size;
+	if (arena->stats.used > arena->stats.peak) {
+		arena->stats.peak = arena->stats.used;
+	}
+	arena->stats.allocs++;
+	return arena->base + offset;
+}
+
+void
+arena_reset(Arena *arena)
+{
+	arena->stats.used = 0;
+}
+
+size_t
+arena_mark(const Arena *arena)
+{
+	return arena->stats.used;
+}
+
+void
+arena_rewind(Arena *arena, size_t mark)
+{
+	if (mark < arena->stats.used) {
+		arena->stats.used = mark;
+	}
+}
+
+int
+pool_init(Pool *pool, size_t block_size, unsigned capacity, size_t align, MemTag tag)
+{
+	memset(pool, 0, sizeof(Pool));
+
+	// blocks hold the free list link while unused
+	if (block_size < sizeof(void*)) {
+		block_size = sizeof(void*);
+	}
+	if (align < sizeof(void*)) {
+		align = sizeof(void*);
+	}
+	block_size = (block_size + align - 1) & ~(align - 1);
+
+	pool->base = alloc_aligned(block_size * capacity, align, &pool->block);
+	if (!pool->base) {
+		return 0;
+	}
+	pool->block_size = block_size;
+	pool->capacity = capacity;
+	pool->stats.tag = tag;
+
+	for (unsigned i = capacity; i > 0; i--) {
+		void **link = (void**)(pool->base + (i - 1) * block_size);
+		*link = pool->free_list;
+		pool->free_list = link;
+	}
+
+	track(&pool->stats);
+	return 1;
+}
+
+void
+pool_free(Pool *pool)
+{
+	if (pool->block) {
+		untrack(&pool->stats);
+		free(pool->block);
+	}
+	memset(pool, 0, sizeof(Pool));
+}
+
+void*
+pool_alloc(Pool *pool)
+{
+	void **link = pool->free_list;
+	if (!link) {
+		return NULL;
+	}
+	pool->free_list = *link;
+
+	pool->stats.used += pool->block_size;
+	if (pool->stats.used > pool->stats.peak) {
+		pool->stats.peak = pool->stats.used;
+	}
+	pool->stats.allocs++;
+	return link;
+}
+
+void
+pool_release(Pool *pool, void *ptr)
+{
+	if (ptr) {
+		void **link = ptr;
+		*link = pool->free_list;
+		pool->free_list = link;
+		pool->stats.used -= pool->block_size;
+	}
+}
+
+static void
+free_thread_arena(void *data)
+{
+	Arena *arena = data;
+	arena_free(arena);
+	free(arena);
+}
+
+int
+mem_init(size_t frame_size)
+{
+	memset(&mem, 0, sizeof(mem));
+	mem.lock = SDL_CreateMutex();
+	mem.tls = SDL_TLSCreate();
+	if (!mem.lock || !mem.tls) {
+		mem_shutdown();
+		return 0;
+	}
+
+	if (!arena_init(&mem.frames[0], frame_size, MEM_FRAME) ||
+	    !arena_init(&mem.frames[1], frame_size, MEM_FRAME)) {
+		mem_shutdown();
+		return 0;
+	}
+	return 1;
+}
+
+void
+mem_shutdown(void)
+{
+	arena_free(&mem.frames[0]);
+	arena_free(&mem.frames[1]);
+	if (mem.lock) {
+		SDL_DestroyMutex(mem.lock);
+		mem.lock = NULL;
+	}
+}
+
+Arena*
+mem_frame(void)
+{
+	return &mem.frames[mem.current];
+}
+
+Arena*
+mem_thread(void)
+{
+	Arena *arena = SDL_TLSGet(mem.tls);
+	if (!arena) {
+		arena = malloc(sizeof(Arena));
+		if (!arena) {
+			return NULL;
+		}
+		if (!arena_init(arena, MEM_THREAD_ARENA_SIZE, MEM_JOBS)) {
+			free(arena);
+			return NULL;
+		}
+		SDL_TLSSet(mem.tls, arena, free_thread_arena);
+	}
+	return arena;
+}
+
+void
+mem_frame_end(void)
+{
+	size_t used[MEM_TAG_COUNT] = { 0 };
+	size_t peak[MEM_TAG_COUNT] = { 0 };
+	unsigned long allocs[MEM_TAG_COUNT] = { 0 };
+
+	// counters of other threads arenas are read without synchronization,
+	// they are only statistics
+	SDL_LockMutex(mem.lock);
+	for (unsigned i = 0; i < mem.count; i++) {
+		const MemStats *s = mem.registered[i];
+		used[s->tag] += s->used;
+		if (s->tag == MEM_FRAME) {
+			// the frame arenas take turns, the peak of a frame is the
+			// largest of theirs
+			peak[s->tag] = s->peak > peak[s->tag] ? s->peak : peak[s->tag];
+		} else {
+			peak[s->tag] += s->peak;
+		}
+		allocs[s->tag] += s->allocs;
+	}
+	SDL_UnlockMutex(mem.lock);
+
+	for (unsigned t = 0; t < MEM_TAG_COUNT; t++) {
+		if (peak[t] == 0) {
+			continue;
+		}
+		prof_count(tag_names[t][0], used[t]);
+		prof_count(tag_names[t][1], peak[t]);
+		// the total drops when an arena or pool is freed
+		unsigned long base = mem.reported_allocs[t] <= allocs[t] ? mem.reported_allocs[t] : 0;
+		prof_count(tag_names[t][2], allocs[t] - base);
+		mem.reported_allocs[t] = allocs[t];
+	}
+
+	mem.current ^= 1;
+	arena_reset(&mem.frames[mem.current]);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stddef.h>
+
+/*******************************************************************************
+ * Linear arenas and fixed-size pools.
+ *
+ * Every arena and pool is tagged with the subsystem it belongs to; usage,
+ * high-water marks and allocation counts are reported per subsystem to the
+ * frame profiler.
+*******************************************************************************/
+
+#define MEM_ALIGN_SIMD 16
+#define MEM_ALIGN_AVX 32
+#define MEM_ALIGN_CACHE 64
+
+#define MEM_THREAD_ARENA_SIZE (1 << 20)
+
+typedef enum MemTag {
+	MEM_FRAME,
+	MEM_JOBS,
+	MEM_SCENE,
+	MEM_MESH,
+	MEM_TAG_COUNT
+} MemTag;
+
+/**
+ * MemStats - Usage counters of an arena or pool.
+ */
+typedef struct MemStats {
+	MemTag tag;
+	size_t used;
+	size_t peak;
+	unsigned long allocs;
+} MemStats;
+
+/**
+ * Arena - Bump allocator, released all at once.
+ */
+typedef struct Arena {
+	MemStats stats;
+	void *block;
+	char *base;
+	size_t size;
+} Arena;
+
+/**
+ * Pool - Allocator of fixed-size blocks.
+ */
+typedef struct Pool {
+	MemStats stats;
+	void *block;
+	char *base;
+	size_t block_size;
+	unsigned capacity;
+	void *free_list;
+} Pool;
+
+/**
+ * Initialize the per-frame arenas and the thread-local arena storage.
+ * Returns 1 on success, 0 on failure.
+ */
+int
+mem_init(size_t frame_size);
+
+void
+mem_shutdown(void);
+
+/**
+ * Arena for the data of the frame being built.
+ *
+ * There are two frame arenas used in turns, so that allocations stay valid
+ * for the whole next frame as well, while the pipeline still consumes them.
+ */
+Arena*
+mem_frame(void);
+
+/**
+ * Report the memory statistics of the frame and switch frame arenas,
+ * resetting the one which becomes current.
+ */
+void
+mem_frame_end(void);
+
+/**
+ * Scratch arena of the calling thread, created on first use.
+ *
+ * Jobs should release what they allocate with arena_mark()/arena_rewind().
+ */
+Arena*
+mem_thread(void);
+
+/*******************************************************************************
+ * Arena operations.
+*******************************************************************************/
+
+int
+arena_init(Arena *arena, size_t size, MemTag tag);
+
+void
+arena_free(Arena *arena);
+
+/**
+ * Allocate `size` bytes aligned to `align`, which must be a power of two not
+ * greater than MEM_ALIGN_CACHE. Returns NULL if the arena is full.
+ */
+void*
+arena_alloc(Arena *arena, size_t size, size_t align);
+
+void
+arena_reset(Arena *arena);
+
+size_t
+arena_mark(const Arena *arena);
+
+void
+arena_rewind(Arena *arena, size_t mark);
+
+/*******************************************************************************
+ * Pool operations.
+*******************************************************************************/
+
+/**
+ * Initialize a pool of `capacity` blocks of `block_size` bytes, each aligned
+ * to `align`. Returns 1 on success, 0 on failure.
+ */
+int
+pool_init(Pool *pool, size_t block_size, unsigned capacity, size_t align, MemTag tag);
+
+void
+pool_free(Pool *pool);
+
+/**
+ * Take a block from the pool, NULL if all are in use.
+ */
+void*
+pool_alloc(Pool *pool);
+
+void
+pool_release(Pool *pool, void *ptr);
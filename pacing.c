@@ -0,0 +1,175 @@
+#include "pacing.h"
+#include "profile.h"
+#include <stdio.h>
+#include <string.h>
+
+// margin left to the busy wait after sleeping, covering the scheduler
+// wake-up latency
+#define SPIN_MARGIN 0.0015
+
+static const char *mode_names[] = {
+	"vsync",
+	"adaptive",
+	"uncapped",
+	"lowlatency",
+};
+
+int
+present_mode_parse(const char *name, PresentMode *r_mode)
+{
+	for (unsigned i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+		if (strcmp(name, mode_names[i]) == 0) {
+			*r_mode = (PresentMode)i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const char*
+present_mode_name(PresentMode mode)
+{
+	return mode_names[mode];
+}
+
+int
+pacer_init(Pacer *pacer, PresentMode mode, double fps)
+{
+	memset(pacer, 0, sizeof(Pacer));
+	pacer->mode = mode;
+	pacer->max_queued = PACER_MAX_QUEUED;
+
+	int interval = 1;
+	switch (mode) {
+	case PRESENT_VSYNC:
+		break;
+	case PRESENT_ADAPTIVE:
+		interval = -1;
+		break;
+	case PRESENT_UNCAPPED:
+		interval = 0;
+		pacer->period = fps > 0 ? 1.0 / fps : 0;
+		break;
+	case PRESENT_LOW_LATENCY:
+		pacer->max_queued = 1;
+		break;
+	}
+
+	if (SDL_GL_SetSwapInterval(interval) != 0) {
+		fprintf(stderr, "swap interval %d not supported: %s\n", interval, SDL_GetError());
+		return 0;
+	}
+
+	glGenQueries(PACER_MAX_QUEUED, pacer->queries);
+	pacer->last_present = pacer->deadline = prof_now();
+	return 1;
+}
+
+void
+pacer_free(Pacer *pacer)
+{
+	while (pacer->queued > 0) {
+		unsigned tail = (pacer->head + PACER_MAX_QUEUED - pacer->queued) % PACER_MAX_QUEUED;
+		glDeleteSync(pacer->fences[tail]);
+		pacer->queued--;
+	}
+	glDeleteQueries(PACER_MAX_QUEUED, pacer->queries);
+}
+
+/*
+ * Retire the oldest queued frame, blocking until the GPU finished it if
+ * `wait` is set. Returns 0 if the frame is still in flight.
+ */
+static int
+retire(Pacer *pacer, int wait)
+{
+	unsigned tail = (pacer->head + PACER_MAX_QUEUED - pacer->queued) % PACER_MAX_QUEUED;
+	GLenum status = glClientWaitSync(
+		pacer->fences[tail],
+		GL_SYNC_FLUSH_COMMANDS_BIT,
+		wait ? 100000000 : 0  // 100ms
+	);
+	if (status == GL_TIMEOUT_EXPIRED && !wait) {
+		return 0;
+	}
+
+	// the frame may have completed well before we got to poll its fence,
+	// so take the completion time from its GPU timestamp, mapped to the
+	// CPU clock through the current GPU time
+	int signaled = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+	if (signaled && pacer->fence_input[tail] > 0) {
+		GLint64 gpu_now = 0;
+		GLuint64 gpu_done = 0;
+		glGetQueryObjectui64v(pacer->queries[tail], GL_QUERY_RESULT, &gpu_done);
+		glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+		double done = prof_now() - ((GLuint64)gpu_now - gpu_done) * 1e-9;
+		prof_time("input latency est", done - pacer->fence_input[tail]);
+	}
+	glDeleteSync(pacer->fences[tail]);
+	pacer->queued--;
+	return 1;
+}
+
+static void
+limit(Pacer *pacer)
+{
+	double now = prof_now();
+	pacer->deadline += pacer->period;
+
+	// start right away when late, and resynchronize instead of rushing to
+	// catch up after falling behind by more than a frame
+	if (now >= pacer->deadline) {
+		if (now > pacer->deadline + pacer->period) {
+			pacer->deadline = now;
+		}
+		return;
+	}
+
+	// sleep until SPIN_MARGIN before the deadline, then spin through the
+	// rest, which the sleep may not be woken up precisely enough for
+	double remaining = pacer->deadline - now;
+	if (remaining > SPIN_MARGIN) {
+		SDL_Delay((Uint32)((remaining - SPIN_MARGIN) * 1000));
+	}
+	while (prof_now() < pacer->deadline) {
+		// spin
+	}
+}
+
+void
+pacer_wait(Pacer *pacer)
+{
+	double start = prof_now();
+
+	// collect the frames the GPU is already done with
+	while (pacer->queued > 0 && retire(pacer, 0)) {
+	}
+
+	// keep the GPU queue depth bounded, in low latency mode this waits for
+	// the previous frame, so that input is sampled as late as possible
+	while (pacer->queued >= pacer->max_queued) {
+		retire(pacer, 1);
+	}
+
+	if (pacer->period > 0) {
+		limit(pacer);
+	}
+
+	prof_time("pacing wait", prof_now() - start);
+}
+
+void
+pacer_present(Pacer *pacer, SDL_Window *win, double input_time)
+{
+	SDL_GL_SwapWindow(win);
+
+	glQueryCounter(pacer->queries[pacer->head], GL_TIMESTAMP);
+	pacer->fences[pacer->head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pacer->fence_input[pacer->head] = input_time;
+	pacer->head = (pacer->head + 1) % PACER_MAX_QUEUED;
+	pacer->queued++;
+
+	double now = prof_now();
+	prof_time("frame interval", now - pacer->last_present);
+	pacer->last_present = now;
+}
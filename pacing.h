@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <SDL.h>
+
+#define PACER_MAX_QUEUED 4
+
+/**
+ * PresentMode - How frames are paced and presented.
+ */
+typedef enum PresentMode {
+	PRESENT_VSYNC,        // swap interval 1
+	PRESENT_ADAPTIVE,     // swap interval -1, tears instead of stalling when late
+	PRESENT_UNCAPPED,     // swap interval 0 with an optional frame limiter
+	PRESENT_LOW_LATENCY,  // vsync, at most one frame queued on the GPU
+} PresentMode;
+
+/**
+ * Pacer - Frame pacing state.
+ *
+ * Each presented frame is followed by a fence, which tells when the GPU has
+ * finished it, and a timestamp query recording when it did. The time from
+ * the newest input event a frame reflects to that timestamp estimates the
+ * input latency: it covers the wait in the event queue, the simulation step
+ * applying the event, the snapshot exchange, rendering and the GPU work, but
+ * not the scan-out. Frames reflecting no new input are not measured. In low
+ * latency mode the pacer also waits for the previous frame fence before the
+ * next frame samples input.
+ */
+typedef struct Pacer {
+	PresentMode mode;
+	double period;
+	double deadline;
+	double last_present;
+	unsigned max_queued;
+	unsigned queued;
+	unsigned head;
+	GLsync fences[PACER_MAX_QUEUED];
+	GLuint queries[PACER_MAX_QUEUED];
+	double fence_input[PACER_MAX_QUEUED];
+} Pacer;
+
+/**
+ * Parse a mode name: "vsync", "adaptive", "uncapped" or "lowlatency".
+ */
+int
+present_mode_parse(const char *name, PresentMode *r_mode);
+
+const char*
+present_mode_name(PresentMode mode);
+
+/**
+ * Set up presentation for the current GL context.
+ *
+ * `fps` limits the frame rate of the uncapped mode, 0 leaves it unlimited.
+ * Returns 1 on success, 0 if the requested mode is not supported.
+ */
+int
+pacer_init(Pacer *pacer, PresentMode mode, double fps);
+
+void
+pacer_free(Pacer *pacer);
+
+/**
+ * Wait until the next frame should start, to be called right before
+ * sampling input.
+ */
+void
+pacer_wait(Pacer *pacer);
+
+/**
+ * Swap the window buffers and record the frame statistics.
+ *
+ * `input_time` is the time of the newest input event which the frame is the
+ * first to reflect, or 0 if there is none.
+ */
+void
+pacer_present(Pacer *pacer, SDL_Window *win, double input_time);
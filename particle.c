@@ -0,0 +1,172 @@
+#include "particle.h"
+#include "job.h"
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+int
+particle_init(ParticleSystem *sys, unsigned capacity)
+{
+	memset(sys, 0, sizeof(ParticleSystem));
+
+	// cache-aligned streams, padded to whole SIMD vectors
+	size_t stream_size = (((capacity + 3) & ~3u) * sizeof(float) + MEM_ALIGN_CACHE - 1) & ~(size_t)(MEM_ALIGN_CACHE - 1);
+	size_t blocks_size = (capacity / PARTICLE_BLOCK + 1) * sizeof(unsigned);
+	if (!arena_init(&sys->arena, stream_size * PARTICLE_STREAM_COUNT + blocks_size, MEM_SCENE)) {
+		return 0;
+	}
+	for (unsigned s = 0; s < PARTICLE_STREAM_COUNT; s++) {
+		sys->stream[s] = arena_alloc(&sys->arena, stream_size, MEM_ALIGN_CACHE);
+	}
+	sys->block_alive = arena_alloc(&sys->arena, blocks_size, sizeof(unsigned));
+	sys->capacity = capacity;
+
+	return 1;
+}
+
+void
+particle_free(ParticleSystem *sys)
+{
+	arena_free(&sys->arena);
+	memset(sys, 0, sizeof(ParticleSystem));
+}
+
+/*
+ * Uniform random number in [-1, 1).
+ */
+static float
+random_signed(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (x >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+unsigned
+particle_emit(ParticleSystem *sys, ParticleEmitter *emitter, float dt)
+{
+	if (emitter->seed == 0) {
+		emitter->seed = 0x9e3779b9u;
+	}
+
+	emitter->accum += emitter->rate * dt;
+	unsigned n = (unsigned)emitter->accum;
+	emitter->accum -= n;
+	if (n > sys->capacity - sys->count) {
+		n = sys->capacity - sys->count;
+	}
+
+	float **s = sys->stream;
+	for (unsigned k = 0, i = sys->count; k < n; k++, i++) {
+		s[PARTICLE_PX][i] = emitter->pos.data[0];
+		s[PARTICLE_PY][i] = emitter->pos.data[1];
+		s[PARTICLE_PZ][i] = emitter->pos.data[2];
+		s[PARTICLE_VX][i] = emitter->vel.data[0] + emitter->spread * random_signed(&emitter->seed);
+		s[PARTICLE_VY][i] = emitter->vel.data[1] + emitter->spread * random_signed(&emitter->seed);
+		s[PARTICLE_VZ][i] = emitter->vel.data[2] + emitter->spread * random_signed(&emitter->seed);
+		s[PARTICLE_AGE][i] = 0;
+		s[PARTICLE_LIFE][i] = emitter->life * (1.0f + 0.25f * random_signed(&emitter->seed));
+		s[PARTICLE_SIZE][i] = emitter->size;
+	}
+	sys->count += n;
+
+	return n;
+}
+
+typedef struct UpdateJob {
+	ParticleSystem *sys;
+	float gravity[3];
+	float dt;
+} UpdateJob;
+
+/*
+ * Integrate a block of particles, then compact its live ones to the front
+ * of the block.
+ */
+static void
+update_blocks(void *data, unsigned begin, unsigned end)
+{
+	UpdateJob *job = data;
+	ParticleSystem *sys = job->sys;
+	float **s = sys->stream;
+	const float dt = job->dt;
+
+	for (unsigned b = begin; b < end; b++) {
+		unsigned first = b * PARTICLE_BLOCK;
+		unsigned last = first + PARTICLE_BLOCK < sys->count ? first + PARTICLE_BLOCK : sys->count;
+		unsigned i = first;
+
+#ifdef __SSE2__
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 gx = _mm_set1_ps(job->gravity[0] * dt);
+		const __m128 gy = _mm_set1_ps(job->gravity[1] * dt);
+		const __m128 gz = _mm_set1_ps(job->gravity[2] * dt);
+		for (; i + 4 <= last; i += 4) {
+			__m128 vx = _mm_add_ps(_mm_load_ps(s[PARTICLE_VX] + i), gx);
+			__m128 vy = _mm_add_ps(_mm_load_ps(s[PARTICLE_VY] + i), gy);
+			__m128 vz = _mm_add_ps(_mm_load_ps(s[PARTICLE_VZ] + i), gz);
+			_mm_store_ps(s[PARTICLE_VX] + i, vx);
+			_mm_store_ps(s[PARTICLE_VY] + i, vy);
+			_mm_store_ps(s[PARTICLE_VZ] + i, vz);
+			_mm_store_ps(s[PARTICLE_PX] + i, _mm_add_ps(_mm_load_ps(s[PARTICLE_PX] + i), _mm_mul_ps(vx, vdt)));
+			_mm_store_ps(s[PARTICLE_PY] + i, _mm_add_ps(_mm_load_ps(s[PARTICLE_PY] + i), _mm_mul_ps(vy, vdt)));
+			_mm_store_ps(s[PARTICLE_PZ] + i, _mm_add_ps(_mm_load_ps(s[PARTICLE_PZ] + i), _mm_mul_ps(vz, vdt)));
+			_mm_store_ps(s[PARTICLE_AGE] + i, _mm_add_ps(_mm_load_ps(s[PARTICLE_AGE] + i), vdt));
+		}
+#endif
+		for (; i < last; i++) {
+			s[PARTICLE_VX][i] += job->gravity[0] * dt;
+			s[PARTICLE_VY][i] += job->gravity[1] * dt;
+			s[PARTICLE_VZ][i] += job->gravity[2] * dt;
+			s[PARTICLE_PX][i] += s[PARTICLE_VX][i] * dt;
+			s[PARTICLE_PY][i] += s[PARTICLE_VY][i] * dt;
+			s[PARTICLE_PZ][i] += s[PARTICLE_VZ][i] * dt;
+			s[PARTICLE_AGE][i] += dt;
+		}
+
+		// every particle is written to the current end of the live ones,
+		// which only advances past the live ones
+		unsigned alive = first;
+		for (i = first; i < last; i++) {
+			for (unsigned k = 0; k < PARTICLE_STREAM_COUNT; k++) {
+				s[k][alive] = s[k][i];
+			}
+			alive += s[PARTICLE_AGE][i] < s[PARTICLE_LIFE][i];
+		}
+		sys->block_alive[b] = alive - first;
+	}
+}
+
+void
+particle_update(ParticleSystem *sys, const Vec *gravity, float dt)
+{
+	if (sys->count == 0) {
+		return;
+	}
+
+	UpdateJob job = {
+		sys,
+		{ gravity->data[0], gravity->data[1], gravity->data[2] },
+		dt
+	};
+	unsigned blocks = (sys->count + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK;
+	job_parallel_for(blocks, 1, update_blocks, &job);
+
+	// close the gaps between blocks
+	unsigned count = sys->block_alive[0];
+	for (unsigned b = 1; b < blocks; b++) {
+		unsigned alive = sys->block_alive[b];
+		if (alive > 0 && count != b * PARTICLE_BLOCK) {
+			for (unsigned k = 0; k < PARTICLE_STREAM_COUNT; k++) {
+				memmove(sys->stream[k] + count, sys->stream[k] + b * PARTICLE_BLOCK, alive * sizeof(float));
+			}
+		}
+		count += alive;
+	}
+	sys->count = count;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "matlib.h"
+#include "mem.h"
+#include <stdint.h>
+
+/*******************************************************************************
+ * Particle simulation.
+ *
+ * Particles are stored as one float stream per attribute and simulated on the
+ * worker threads, four at a time with SIMD. Dead particles are removed by
+ * compacting the streams without branching, so the live particles always
+ * occupy [0, count) in emission order.
+ *
+ * This is the reference implementation; particle_gl can run the same
+ * simulation on the GPU.
+*******************************************************************************/
+
+#define PARTICLE_BLOCK 4096
+
+/**
+ * Particle attribute streams, in the order of the interleaved GPU records.
+ */
+enum {
+	PARTICLE_PX,
+	PARTICLE_PY,
+	PARTICLE_PZ,
+	PARTICLE_VX,
+	PARTICLE_VY,
+	PARTICLE_VZ,
+	PARTICLE_AGE,
+	PARTICLE_LIFE,
+	PARTICLE_SIZE,
+	PARTICLE_STREAM_COUNT
+};
+
+/**
+ * ParticleSystem - Live particles in SoA layout.
+ */
+typedef struct ParticleSystem {
+	Arena arena;
+	float *stream[PARTICLE_STREAM_COUNT];
+	unsigned count;
+	unsigned capacity;
+	unsigned *block_alive;
+} ParticleSystem;
+
+/**
+ * ParticleEmitter - Continuous particle source.
+ *
+ * Particles start at `pos` with velocity `vel` randomized by up to `spread`
+ * on each axis and live for `life` seconds, randomized by up to 25%.
+ */
+typedef struct ParticleEmitter {
+	Vec pos;
+	Vec vel;
+	float spread;
+	float rate;
+	float life;
+	float size;
+	float accum;
+	uint32_t seed;
+} ParticleEmitter;
+
+/**
+ * Allocate storage for `capacity` particles. Returns 1 on success, 0 on
+ * failure.
+ */
+int
+particle_init(ParticleSystem *sys, unsigned capacity);
+
+void
+particle_free(ParticleSystem *sys);
+
+/**
+ * Append the particles emitted over `dt` seconds, as many as fit.
+ *
+ * Returns the number of particles emitted.
+ */
+unsigned
+particle_emit(ParticleSystem *sys, ParticleEmitter *emitter, float dt);
+
+/**
+ * Advance the particles by `dt` seconds under constant acceleration `gravity`
+ * and remove the dead ones, on the worker threads.
+ */
+void
+particle_update(ParticleSystem *sys, const Vec *gravity, float dt);
@@ -0,0 +1,305 @@
+#include "particle_gl.h"
+#include "shader.h"
+#include <stddef.h>
+#include <string.h>
+
+#define STRIDE (PARTICLE_STREAM_COUNT * sizeof(float))
+
+static const char *sim_vs =
+	"#version 330 core\n"
+	"layout(location = 0) in vec3 position;\n"
+	"layout(location = 1) in vec3 velocity;\n"
+	"layout(location = 2) in float age;\n"
+	"layout(location = 3) in float life;\n"
+	"layout(location = 4) in float size;\n"
+	"uniform vec3 gravity;\n"
+	"uniform float dt;\n"
+	"out vec3 g_position;\n"
+	"out vec3 g_velocity;\n"
+	"out float g_age;\n"
+	"out float g_life;\n"
+	"out float g_size;\n"
+	"void main() {\n"
+	"	g_velocity = velocity + gravity * dt;\n"
+	"	g_position = position + g_velocity * dt;\n"
+	"	g_age = age + dt;\n"
+	"	g_life = life;\n"
+	"	g_size = size;\n"
+	"}\n";
+
+static const char *sim_gs =
+	"#version 330 core\n"
+	"layout(points) in;\n"
+	"layout(points, max_vertices = 1) out;\n"
+	"in vec3 g_position[];\n"
+	"in vec3 g_velocity[];\n"
+	"in float g_age[];\n"
+	"in float g_life[];\n"
+	"in float g_size[];\n"
+	"out vec3 out_position;\n"
+	"out vec3 out_velocity;\n"
+	"out float out_age;\n"
+	"out float out_life;\n"
+	"out float out_size;\n"
+	"void main() {\n"
+	"	if (g_age[0] < g_life[0]) {\n"
+	"		out_position = g_position[0];\n"
+	"		out_velocity = g_velocity[0];\n"
+	"		out_age = g_age[0];\n"
+	"		out_life = g_life[0];\n"
+	"		out_size = g_size[0];\n"
+	"		EmitVertex();\n"
+	"		EndPrimitive();\n"
+	"	}\n"
+	"}\n";
+
+static const char *sim_varyings[] = {
+	"out_position",
+	"out_velocity",
+	"out_age",
+	"out_life",
+	"out_size",
+};
+
+static const char *draw_vs =
+	"#version 330 core\n"
+	"layout(location = 0) in vec3 position;\n"
+	"layout(location = 2) in float age;\n"
+	"layout(location = 3) in float life;\n"
+	"layout(location = 4) in float size;\n"
+	"uniform mat4 view_proj;\n"
+	"uniform vec3 camera_right;\n"
+	"uniform vec3 camera_up;\n"
+	"out vec2 v_corner;\n"
+	"out float v_fade;\n"
+	"const vec2 corners[4] = vec2[4](\n"
+	"	vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0)\n"
+	");\n"
+	"void main() {\n"
+	"	v_corner = corners[gl_VertexID];\n"
+	"	v_fade = 1.0 - clamp(age / life, 0.0, 1.0);\n"
+	"	vec3 p = position + (camera_right * v_corner.x + camera_up * v_corner.y) * size;\n"
+	"	gl_Position = view_proj * vec4(p, 1.0);\n"
+	"}\n";
+
+static const char *draw_fs =
+	"#version 330 core\n"
+	"in vec2 v_corner;\n"
+	"in float v_fade;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	float a = max(1.0 - dot(v_corner, v_corner), 0.0) * v_fade;\n"
+	"	color = vec4(vec3(1.0, 0.8, 0.5) * a, a);\n"
+	"}\n";
+
+/*
+ * Bind the attributes of the interleaved records in `buffer` to the currently
+ * bound VAO, advancing per instance when `instanced` is set.
+ */
+static void
+record_layout(GLuint buffer, int instanced)
+{
+	static const struct {
+		GLint size;
+		unsigned stream;
+	} attribs[] = {
+		{ 3, PARTICLE_PX },
+		{ 3, PARTICLE_VX },
+		{ 1, PARTICLE_AGE },
+		{ 1, PARTICLE_LIFE },
+		{ 1, PARTICLE_SIZE },
+	};
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (unsigned i = 0; i < sizeof(attribs) / sizeof(attribs[0]); i++) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(
+			i,
+			attribs[i].size,
+			GL_FLOAT,
+			GL_FALSE,
+			STRIDE,
+			(const void*)(attribs[i].stream * sizeof(float))
+		);
+		glVertexAttribDivisor(i, instanced ? 1 : 0);
+	}
+}
+
+int
+particle_gl_init(ParticleGL *pgl, unsigned capacity, int want_gpu)
+{
+	memset(pgl, 0, sizeof(ParticleGL));
+	pgl->capacity = capacity;
+
+	pgl->draw_program = shader_program(draw_vs, draw_fs);
+	if (!pgl->draw_program) {
+		return 0;
+	}
+	if (want_gpu && GLEW_VERSION_3_2) {
+		pgl->sim_program = shader_feedback_program(sim_vs, sim_gs, sim_varyings, 5);
+		pgl->gpu = pgl->sim_program != 0;
+	}
+
+	glGenBuffers(2, pgl->buffers);
+	glGenVertexArrays(2, pgl->sim_vaos);
+	glGenVertexArrays(2, pgl->draw_vaos);
+	glGenQueries(1, &pgl->query);
+	for (unsigned i = 0; i < 2; i++) {
+		glBindBuffer(GL_ARRAY_BUFFER, pgl->buffers[i]);
+		glBufferData(GL_ARRAY_BUFFER, capacity * STRIDE, NULL, GL_STREAM_DRAW);
+
+		glBindVertexArray(pgl->sim_vaos[i]);
+		record_layout(pgl->buffers[i], 0);
+		glBindVertexArray(pgl->draw_vaos[i]);
+		record_layout(pgl->buffers[i], 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void
+particle_gl_free(ParticleGL *pgl)
+{
+	glDeleteQueries(1, &pgl->query);
+	glDeleteVertexArrays(2, pgl->draw_vaos);
+	glDeleteVertexArrays(2, pgl->sim_vaos);
+	glDeleteBuffers(2, pgl->buffers);
+	glDeleteProgram(pgl->sim_program);
+	glDeleteProgram(pgl->draw_program);
+	memset(pgl, 0, sizeof(ParticleGL));
+}
+
+/*
+ * Interleave particles [first, first + count) of `sys` into `dst`.
+ */
+static void
+interleave(const ParticleSystem *sys, unsigned first, unsigned count, float *dst)
+{
+	for (unsigned i = first; i < first + count; i++) {
+		for (unsigned s = 0; s < PARTICLE_STREAM_COUNT; s++) {
+			*dst++ = sys->stream[s][i];
+		}
+	}
+}
+
+void
+particle_gl_upload(ParticleGL *pgl, const ParticleSystem *sys)
+{
+	unsigned count = sys->count < pgl->capacity ? sys->count : pgl->capacity;
+
+	// orphan the previous storage so that we don't wait for draws still
+	// reading from it
+	glBindBuffer(GL_ARRAY_BUFFER, pgl->buffers[pgl->current]);
+	glBufferData(GL_ARRAY_BUFFER, pgl->capacity * STRIDE, NULL, GL_STREAM_DRAW);
+	float *dst = count ? glMapBufferRange(
+		GL_ARRAY_BUFFER,
+		0,
+		count * STRIDE,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+	) : NULL;
+	if (dst) {
+		interleave(sys, 0, count, dst);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	pgl->count = dst ? count : 0;
+	pgl->drawn = pgl->current;
+	pgl->draw_count = pgl->count;
+}
+
+/*
+ * Fetch the number of particles which survived the last simulation pass,
+ * issued a frame ago, which the GPU has normally finished by now.
+ */
+static void
+resolve(ParticleGL *pgl)
+{
+	if (pgl->pending) {
+		GLuint count = 0;
+		glGetQueryObjectuiv(pgl->query, GL_QUERY_RESULT, &count);
+		pgl->count = count;
+		pgl->pending = 0;
+	}
+}
+
+void
+particle_gl_simulate(ParticleGL *pgl, const ParticleSystem *spawned, const Vec *gravity, float dt)
+{
+	if (!pgl->gpu) {
+		return;
+	}
+	resolve(pgl);
+
+	// append the new particles past the live ones; the GPU is done with
+	// that range since the previous pass completed, along with the draws
+	// issued before it
+	GLuint src = pgl->buffers[pgl->current], dst = pgl->buffers[!pgl->current];
+	unsigned n = spawned->count < pgl->capacity - pgl->count ? spawned->count : pgl->capacity - pgl->count;
+	if (n > 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, src);
+		float *p = glMapBufferRange(
+			GL_ARRAY_BUFFER,
+			pgl->count * STRIDE,
+			n * STRIDE,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+		);
+		if (p) {
+			interleave(spawned, 0, n, p);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		} else {
+			n = 0;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	glUseProgram(pgl->sim_program);
+	glUniform3f(glGetUniformLocation(pgl->sim_program, "gravity"), gravity->data[0], gravity->data[1], gravity->data[2]);
+	glUniform1f(glGetUniformLocation(pgl->sim_program, "dt"), dt);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(pgl->sim_vaos[pgl->current]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, dst);
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, pgl->query);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, pgl->count + n);
+	glEndTransformFeedback();
+	glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	// the input of the pass is complete and its count known, draw it
+	// rather than waiting for the output
+	pgl->drawn = pgl->current;
+	pgl->draw_count = pgl->count + n;
+	pgl->current = !pgl->current;
+	pgl->pending = 1;
+}
+
+void
+particle_gl_draw(ParticleGL *pgl, const Mat *view_proj, const Vec *right, const Vec *up)
+{
+	if (pgl->draw_count == 0) {
+		return;
+	}
+
+	GLuint prog = pgl->draw_program;
+	glUseProgram(prog);
+	glUniformMatrix4fv(glGetUniformLocation(prog, "view_proj"), 1, GL_TRUE, view_proj->data);
+	glUniform3f(glGetUniformLocation(prog, "camera_right"), right->data[0], right->data[1], right->data[2]);
+	glUniform3f(glGetUniformLocation(prog, "camera_up"), up->data[0], up->data[1], up->data[2]);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glDepthMask(GL_FALSE);
+
+	glBindVertexArray(pgl->draw_vaos[pgl->drawn]);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, pgl->draw_count);
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "particle.h"
+#include <GL/glew.h>
+
+/**
+ * ParticleGL - GPU particle storage, simulation and instanced rendering.
+ *
+ * Particles are stored as interleaved records of PARTICLE_STREAM_COUNT floats
+ * in two buffers. On the CPU path the live particles of a ParticleSystem are
+ * uploaded every frame; on the GPU path the same simulation runs as a
+ * transform feedback pass ping-ponging between the buffers, with a geometry
+ * shader dropping the dead particles.
+ *
+ * The number of particles surviving a pass is only read back before the next
+ * one, a frame later, so that nothing waits for the GPU in between; the GPU
+ * path draws the input of the last pass, whose count is known.
+ */
+typedef struct ParticleGL {
+	GLuint buffers[2];
+	GLuint sim_vaos[2];
+	GLuint draw_vaos[2];
+	GLuint sim_program;
+	GLuint draw_program;
+	GLuint query;
+	unsigned capacity;
+	unsigned count;
+	unsigned current;
+	unsigned drawn;
+	unsigned draw_count;
+	int gpu;
+	int pending;
+} ParticleGL;
+
+/**
+ * Create storage for `capacity` particles and the programs. When `want_gpu`
+ * is set and the context supports geometry shaders, the GPU simulation path
+ * is enabled.
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int
+particle_gl_init(ParticleGL *pgl, unsigned capacity, int want_gpu);
+
+void
+particle_gl_free(ParticleGL *pgl);
+
+/**
+ * CPU path: upload the live particles of `sys`.
+ */
+void
+particle_gl_upload(ParticleGL *pgl, const ParticleSystem *sys);
+
+/**
+ * GPU path: append the particles of `spawned`, then advance all of them by
+ * `dt` seconds. `spawned` is a staging system the caller emits into and
+ * empties after each call.
+ */
+void
+particle_gl_simulate(ParticleGL *pgl, const ParticleSystem *spawned, const Vec *gravity, float dt);
+
+/**
+ * Draw the particles as camera-facing quads, additively blended. On the GPU
+ * path they are drawn as they were before the last simulation pass.
+ *
+ * `right` and `up` are the camera axes in the space of the particles.
+ */
+void
+particle_gl_draw(ParticleGL *pgl, const Mat *view_proj, const Vec *right, const Vec *up);
@@ -0,0 +1,311 @@
+#include "post.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// weight of a new GPU time measurement in the running average
+#define SCALER_SMOOTHING 0.25
+// fraction of the budget to aim for, and below which to scale up
+#define SCALER_TARGET 0.9
+#define SCALER_HEADROOM 0.8
+#define SCALER_MAX_STEP_UP 0.05f
+// scales are multiples of 1 / SCALER_STEPS, to avoid changing every frame
+#define SCALER_STEPS 32.0f
+// frames to wait after a change, covering the timer query latency
+#define SCALER_SETTLE 8
+
+unsigned
+post_format_bytes(PostFormat format)
+{
+	switch (format) {
+	case POST_RGBA16F:
+		return 8;
+	case POST_RGBA8:
+	case POST_R11G11B10F:
+	case POST_DEPTH24:
+	case POST_DEPTH32F:
+	default:
+		return 4;
+	}
+}
+
+void
+post_init(PostGraph *graph, unsigned display_width, unsigned display_height, float max_scale)
+{
+	memset(graph, 0, sizeof(PostGraph));
+	graph->display_width = display_width;
+	graph->display_height = display_height;
+	graph->max_scale = max_scale;
+}
+
+unsigned
+post_target(PostGraph *graph, const char *name, PostFormat format, PostSpace space, float scale)
+{
+	if (graph->target_count == POST_MAX_TARGETS) {
+		return POST_NONE;
+	}
+	PostTarget *t = &graph->targets[graph->target_count];
+	memset(t, 0, sizeof(PostTarget));
+	t->name = name;
+	t->format = format;
+	t->space = space;
+	t->scale = scale;
+	t->slot = POST_NONE;
+	graph->compiled = 0;
+	return graph->target_count++;
+}
+
+unsigned
+post_pass(
+	PostGraph *graph,
+	const char *name,
+	PostPassFunc fn,
+	void *data,
+	unsigned color,
+	unsigned depth
+) {
+	if (graph->pass_count == POST_MAX_PASSES) {
+		return POST_NONE;
+	}
+	PostPass *p = &graph->passes[graph->pass_count];
+	memset(p, 0, sizeof(PostPass));
+	p->name = name;
+	p->fn = fn;
+	p->data = data;
+	p->color = color;
+	p->depth = depth;
+	graph->compiled = 0;
+	return graph->pass_count++;
+}
+
+int
+post_read(PostGraph *graph, unsigned pass, unsigned target)
+{
+	PostPass *p = &graph->passes[pass];
+	if (p->input_count == POST_MAX_INPUTS) {
+		return 0;
+	}
+	p->inputs[p->input_count++] = target;
+	graph->compiled = 0;
+	return 1;
+}
+
+void
+post_resize(PostGraph *graph, unsigned display_width, unsigned display_height)
+{
+	graph->display_width = display_width;
+	graph->display_height = display_height;
+	graph->compiled = 0;
+}
+
+static unsigned
+extent(unsigned size, float scale)
+{
+	unsigned n = (unsigned)ceilf(size * scale);
+	return n ? n : 1;
+}
+
+static void
+target_size(const PostGraph *graph, const PostTarget *t, float scale, unsigned *r_width, unsigned *r_height)
+{
+	if (t->space == POST_RENDER) {
+		scale *= t->scale;
+	} else {
+		scale = t->scale;
+	}
+	*r_width = extent(graph->display_width, scale);
+	*r_height = extent(graph->display_height, scale);
+}
+
+void
+post_target_size(
+	const PostGraph *graph,
+	unsigned target,
+	float render_scale,
+	unsigned *r_width,
+	unsigned *r_height
+) {
+	if (render_scale > graph->max_scale) {
+		render_scale = graph->max_scale;
+	}
+	target_size(graph, &graph->targets[target], render_scale, r_width, r_height);
+}
+
+static int
+is_target(const PostGraph *graph, unsigned target)
+{
+	return target < graph->target_count;
+}
+
+static void
+use(PostTarget *t, unsigned pass)
+{
+	if (t->first == POST_NONE) {
+		t->first = pass;
+	}
+	t->last = pass;
+}
+
+int
+post_compile(PostGraph *graph)
+{
+	int written[POST_MAX_TARGETS] = { 0 };
+	int needed[POST_MAX_TARGETS] = { 0 };
+
+	for (unsigned t = 0; t < graph->target_count; t++) {
+		graph->targets[t].first = POST_NONE;
+		graph->targets[t].last = 0;
+		graph->targets[t].slot = POST_NONE;
+	}
+
+	// every input must have been written by an earlier pass
+	for (unsigned i = 0; i < graph->pass_count; i++) {
+		PostPass *p = &graph->passes[i];
+		for (unsigned j = 0; j < p->input_count; j++) {
+			unsigned t = p->inputs[j];
+			if (!is_target(graph, t) || !written[t] || t == p->color || t == p->depth) {
+				fprintf(stderr, "pass %s reads a target which is not ready\n", p->name);
+				return 0;
+			}
+		}
+		if ((p->color != POST_NONE && p->color != POST_BACKBUFFER && !is_target(graph, p->color)) ||
+		    (p->depth != POST_NONE && !is_target(graph, p->depth)) ||
+		    (p->color == POST_BACKBUFFER && p->depth != POST_NONE)) {
+			fprintf(stderr, "pass %s writes an invalid target\n", p->name);
+			return 0;
+		}
+		if (is_target(graph, p->color)) {
+			written[p->color] = 1;
+		}
+		if (is_target(graph, p->depth)) {
+			written[p->depth] = 1;
+		}
+	}
+
+	// walking backwards from the display, keep the passes writing targets
+	// which later passes read
+	for (unsigned i = graph->pass_count; i-- > 0; ) {
+		PostPass *p = &graph->passes[i];
+		p->culled = !(p->color == POST_BACKBUFFER ||
+		              (is_target(graph, p->color) && needed[p->color]) ||
+		              (is_target(graph, p->depth) && needed[p->depth]));
+		for (unsigned j = 0; !p->culled && j < p->input_count; j++) {
+			needed[p->inputs[j]] = 1;
+		}
+	}
+
+	for (unsigned i = 0; i < graph->pass_count; i++) {
+		PostPass *p = &graph->passes[i];
+		if (p->culled) {
+			continue;
+		}
+		for (unsigned j = 0; j < p->input_count; j++) {
+			use(&graph->targets[p->inputs[j]], i);
+		}
+		if (is_target(graph, p->color)) {
+			use(&graph->targets[p->color], i);
+		}
+		if (is_target(graph, p->depth)) {
+			use(&graph->targets[p->depth], i);
+		}
+	}
+
+	// assign slots in execution order, reusing the slots of targets which
+	// are dead by the time a target is first written
+	int free_slot[POST_MAX_TARGETS] = { 0 };
+	graph->slot_count = 0;
+	graph->target_bytes = 0;
+	graph->slot_bytes = 0;
+	for (unsigned i = 0; i < graph->pass_count; i++) {
+		for (unsigned t = 0; t < graph->target_count; t++) {
+			PostTarget *target = &graph->targets[t];
+			if (target->first != i) {
+				continue;
+			}
+
+			unsigned width, height;
+			target_size(graph, target, graph->max_scale, &width, &height);
+			size_t bytes = (size_t)width * height * post_format_bytes(target->format);
+			graph->target_bytes += bytes;
+
+			for (unsigned s = 0; s < graph->slot_count; s++) {
+				PostSlot *slot = &graph->slots[s];
+				if (free_slot[s] && slot->format == target->format &&
+				    slot->width == width && slot->height == height) {
+					target->slot = s;
+					free_slot[s] = 0;
+					break;
+				}
+			}
+			if (target->slot == POST_NONE) {
+				target->slot = graph->slot_count++;
+				graph->slots[target->slot] = (PostSlot){ target->format, width, height };
+				graph->slot_bytes += bytes;
+			}
+		}
+
+		for (unsigned t = 0; t < graph->target_count; t++) {
+			const PostTarget *target = &graph->targets[t];
+			if (target->slot != POST_NONE && target->last == i) {
+				free_slot[target->slot] = 1;
+			}
+		}
+	}
+
+	graph->compiled = 1;
+	return 1;
+}
+
+void
+post_scaler_init(PostScaler *scaler, double budget, float min_scale, float max_scale)
+{
+	memset(scaler, 0, sizeof(PostScaler));
+	scaler->budget = budget;
+	scaler->min_scale = min_scale;
+	scaler->max_scale = max_scale;
+	scaler->scale = max_scale;
+}
+
+float
+post_scaler_update(PostScaler *scaler, double gpu_time)
+{
+	if (gpu_time <= 0 || scaler->budget <= 0) {
+		return scaler->scale;
+	}
+
+	if (scaler->filtered > 0) {
+		scaler->filtered += SCALER_SMOOTHING * (gpu_time - scaler->filtered);
+	} else {
+		scaler->filtered = gpu_time;
+	}
+
+	if (scaler->settle > 0) {
+		scaler->settle--;
+		return scaler->scale;
+	}
+
+	// frame time scales with the pixel count, the square of the scale
+	float scale = scaler->scale;
+	float ideal = scale * sqrt(scaler->budget * SCALER_TARGET / scaler->filtered);
+	if (scaler->filtered > scaler->budget) {
+		scale = ideal;
+	} else if (scaler->filtered < scaler->budget * SCALER_HEADROOM) {
+		scale = ideal < scale + SCALER_MAX_STEP_UP ? ideal : scale + SCALER_MAX_STEP_UP;
+	}
+
+	scale = floorf(scale * SCALER_STEPS) / SCALER_STEPS;
+	if (scale < scaler->min_scale) {
+		scale = scaler->min_scale;
+	} else if (scale > scaler->max_scale) {
+		scale = scaler->max_scale;
+	}
+
+	if (scale != scaler->scale) {
+		// predict the time at the new scale until measurements catch up
+		float ratio = scale / scaler->scale;
+		scaler->filtered *= ratio * ratio;
+		scaler->scale = scale;
+		scaler->settle = SCALER_SETTLE;
+	}
+	return scaler->scale;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Render target graph.
+ *
+ * A frame is described as a list of passes reading and writing transient
+ * targets, declared in execution order. Compiling the graph drops the passes
+ * whose results are never used, computes the lifetime of every target and
+ * assigns targets whose lifetimes don't overlap to the same physical slot
+ * when they share format and size, so that the frame needs as little memory
+ * as possible.
+ *
+ * Targets in render space scale with the dynamic render resolution. They are
+ * allocated once at the maximum scale and only the region matching the
+ * current scale is rendered to, so that scaling never reallocates them; a
+ * final pass upscales the result to the display.
+*******************************************************************************/
+
+#define POST_MAX_TARGETS 32
+#define POST_MAX_PASSES 32
+#define POST_MAX_INPUTS 4
+
+#define POST_NONE 0xffffffffu
+#define POST_BACKBUFFER 0xfffffffeu
+
+typedef enum PostFormat {
+	POST_RGBA8,
+	POST_RGBA16F,
+	POST_R11G11B10F,
+	POST_DEPTH24,
+	POST_DEPTH32F,
+	POST_FORMAT_COUNT
+} PostFormat;
+
+typedef enum PostSpace {
+	POST_RENDER,   // scales with the render resolution
+	POST_DISPLAY,  // fixed fraction of the display resolution
+} PostSpace;
+
+/**
+ * PostContext - What a pass needs to know when executed.
+ *
+ * The output is bound and its viewport set before the pass is called.
+ * Inputs only hold the rendered image in [0, uv_scale] of their texture
+ * coordinates.
+ */
+typedef struct PostContext {
+	uint32_t inputs[POST_MAX_INPUTS];
+	float uv_scale[POST_MAX_INPUTS][2];
+	unsigned input_count;
+	unsigned width, height;
+} PostContext;
+
+/**
+ * PostPassFunc - Function drawing a pass.
+ */
+typedef void (*PostPassFunc)(void *data, const PostContext *ctx);
+
+/**
+ * PostTarget - Transient target and its compiled lifetime and slot.
+ */
+typedef struct PostTarget {
+	const char *name;
+	PostFormat format;
+	PostSpace space;
+	float scale;
+	unsigned first, last;
+	unsigned slot;
+} PostTarget;
+
+/**
+ * PostPass - Pass and the targets it reads and writes.
+ *
+ * `name` is also the profiler entry of the pass, and must outlive the graph.
+ */
+typedef struct PostPass {
+	const char *name;
+	PostPassFunc fn;
+	void *data;
+	unsigned inputs[POST_MAX_INPUTS];
+	unsigned input_count;
+	unsigned color;
+	unsigned depth;
+	int culled;
+} PostPass;
+
+/**
+ * PostSlot - Physical allocation shared by aliased targets.
+ */
+typedef struct PostSlot {
+	PostFormat format;
+	unsigned width, height;
+} PostSlot;
+
+/**
+ * PostGraph - Passes and targets of a frame, and their memory layout.
+ */
+typedef struct PostGraph {
+	PostTarget targets[POST_MAX_TARGETS];
+	unsigned target_count;
+	PostPass passes[POST_MAX_PASSES];
+	unsigned pass_count;
+
+	// compiled layout
+	PostSlot slots[POST_MAX_TARGETS];
+	unsigned slot_count;
+	size_t target_bytes;  // without aliasing
+	size_t slot_bytes;    // with aliasing
+	int compiled;
+
+	unsigned display_width, display_height;
+	float max_scale;
+} PostGraph;
+
+/**
+ * Bytes per texel of a format.
+ */
+unsigned
+post_format_bytes(PostFormat format);
+
+static inline int
+post_format_is_depth(PostFormat format)
+{
+	return format == POST_DEPTH24 || format == POST_DEPTH32F;
+}
+
+/**
+ * Set up an empty graph for given display size, with render targets
+ * scaling up to `max_scale` of it.
+ */
+void
+post_init(PostGraph *graph, unsigned display_width, unsigned display_height, float max_scale);
+
+/**
+ * Declare a target of `scale` times the size of its space.
+ *
+ * Returns the target index, or POST_NONE if the graph is full.
+ */
+unsigned
+post_target(PostGraph *graph, const char *name, PostFormat format, PostSpace space, float scale);
+
+/**
+ * Declare a pass drawing into `color` and `depth`, each a target, or
+ * POST_NONE; `color` may also be POST_BACKBUFFER for the display, which comes
+ * with its own depth buffer.
+ *
+ * Returns the pass index, or POST_NONE if the graph is full.
+ */
+unsigned
+post_pass(
+	PostGraph *graph,
+	const char *name,
+	PostPassFunc fn,
+	void *data,
+	unsigned color,
+	unsigned depth
+);
+
+/**
+ * Make `pass` read `target`, as its next input. Returns 1 on success, 0 if
+ * the pass has too many inputs.
+ */
+int
+post_read(PostGraph *graph, unsigned pass, unsigned target);
+
+/**
+ * Cull, compute the target lifetimes and assign slots; needed again after
+ * any change to the graph or display size.
+ *
+ * Returns 1 on success, 0 if a target is read before being written or a
+ * pass writes an invalid target.
+ */
+int
+post_compile(PostGraph *graph);
+
+/**
+ * Change the display size. The graph must be compiled again.
+ */
+void
+post_resize(PostGraph *graph, unsigned display_width, unsigned display_height);
+
+/**
+ * Size of the region of `target` rendered to at given render scale.
+ */
+void
+post_target_size(
+	const PostGraph *graph,
+	unsigned target,
+	float render_scale,
+	unsigned *r_width,
+	unsigned *r_height
+);
+
+/*******************************************************************************
+ * Dynamic resolution.
+*******************************************************************************/
+
+/**
+ * PostScaler - Render scale controller keeping the GPU frame time within a
+ * budget.
+ */
+typedef struct PostScaler {
+	double budget;
+	double filtered;
+	float min_scale, max_scale;
+	float scale;
+	unsigned settle;
+} PostScaler;
+
+void
+post_scaler_init(PostScaler *scaler, double budget, float min_scale, float max_scale);
+
+/**
+ * Feed the GPU time of a frame in seconds, or 0 when none was measured, and
+ * return the render scale to use for the next one.
+ *
+ * The cost of a frame is assumed proportional to its pixel count: the scale
+ * drops quickly when over budget and recovers slowly when there is headroom,
+ * waiting for the measurements to settle after each change.
+ */
+float
+post_scaler_update(PostScaler *scaler, double gpu_time);
@@ -0,0 +1,363 @@
+#include "post_gl.h"
+#include "profile.h"
+#include "shader.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MIB (1024.0 * 1024.0)
+
+static const struct {
+	GLenum internal;
+	GLenum format;
+	GLenum type;
+} formats[POST_FORMAT_COUNT] = {
+	[POST_RGBA8] = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+	[POST_RGBA16F] = { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+	[POST_R11G11B10F] = { GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT },
+	[POST_DEPTH24] = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+	[POST_DEPTH32F] = { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT },
+};
+
+// full-screen triangle, without vertex buffers
+static const char *upscale_vs =
+	"#version 330 core\n"
+	"out vec2 uv;\n"
+	"void main() {\n"
+	"	uv = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0;\n"
+	"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}\n";
+
+static const char *upscale_fs =
+	"#version 330 core\n"
+	"uniform sampler2D source;\n"
+	"uniform vec2 uv_scale;\n"
+	"uniform float sharpness;\n"
+	"in vec2 uv;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"	vec2 texel = 1.0 / vec2(textureSize(source, 0));\n"
+	"	// stay half a texel inside the rendered region, so that filtering\n"
+	"	// never blends in stale texels past its edge; the sharpening taps\n"
+	"	// as well\n"
+	"	vec2 lo = texel * 0.5, hi = uv_scale - texel * 0.5;\n"
+	"	vec2 p = clamp(uv * uv_scale, lo, hi);\n"
+	"	vec4 c = texture(source, p);\n"
+	"	vec4 blur = 0.25 * (\n"
+	"		texture(source, clamp(p + vec2(texel.x, 0.0), lo, hi)) +\n"
+	"		texture(source, clamp(p - vec2(texel.x, 0.0), lo, hi)) +\n"
+	"		texture(source, clamp(p + vec2(0.0, texel.y), lo, hi)) +\n"
+	"		texture(source, clamp(p - vec2(0.0, texel.y), lo, hi)));\n"
+	"	color = c + (c - blur) * sharpness;\n"
+	"}\n";
+
+static int
+create_target(RenderTarget *rt, PostFormat format, unsigned width, unsigned height)
+{
+	memset(rt, 0, sizeof(RenderTarget));
+	rt->format = format;
+	rt->width = width;
+	rt->height = height;
+
+	GLenum filter = post_format_is_depth(format) ? GL_NEAREST : GL_LINEAR;
+	glGenTextures(1, &rt->texture);
+	glBindTexture(GL_TEXTURE_2D, rt->texture);
+	glTexImage2D(
+		GL_TEXTURE_2D,
+		0,
+		formats[format].internal,
+		width,
+		height,
+		0,
+		formats[format].format,
+		formats[format].type,
+		NULL
+	);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &rt->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo);
+	if (post_format_is_depth(format)) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, rt->texture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	} else {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rt->texture, 0);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "render target %ux%u of format %d is incomplete\n", width, height, format);
+		glDeleteFramebuffers(1, &rt->fbo);
+		glDeleteTextures(1, &rt->texture);
+		return 0;
+	}
+	return 1;
+}
+
+static void
+delete_target(TargetPool *pool, RenderTarget *rt)
+{
+	// texture names get reused, forget where this one is attached
+	for (unsigned i = 0; i < POST_POOL_SIZE; i++) {
+		if (pool->targets[i].depth == rt->texture) {
+			pool->targets[i].depth = 0;
+		}
+	}
+
+	pool->bytes -= (size_t)rt->width * rt->height * post_format_bytes(rt->format);
+	glDeleteFramebuffers(1, &rt->fbo);
+	glDeleteTextures(1, &rt->texture);
+	memset(rt, 0, sizeof(RenderTarget));
+	pool->count--;
+}
+
+RenderTarget*
+target_pool_acquire(TargetPool *pool, PostFormat format, unsigned width, unsigned height)
+{
+	RenderTarget *empty = NULL, *oldest = NULL;
+	for (unsigned i = 0; i < POST_POOL_SIZE; i++) {
+		RenderTarget *rt = &pool->targets[i];
+		if (!rt->texture) {
+			empty = empty ? empty : rt;
+		} else if (!rt->in_use) {
+			if (rt->format == format && rt->width == width && rt->height == height) {
+				rt->in_use = 1;
+				rt->last_used = pool->frame;
+				return rt;
+			}
+			if (!oldest || rt->last_used < oldest->last_used) {
+				oldest = rt;
+			}
+		}
+	}
+
+	// make room by dropping the least recently used free target
+	RenderTarget *rt = empty;
+	if (!rt) {
+		if (!oldest) {
+			fprintf(stderr, "render target pool exhausted\n");
+			return NULL;
+		}
+		delete_target(pool, oldest);
+		rt = oldest;
+	}
+
+	if (!create_target(rt, format, width, height)) {
+		memset(rt, 0, sizeof(RenderTarget));
+		return NULL;
+	}
+	rt->in_use = 1;
+	rt->last_used = pool->frame;
+	pool->bytes += (size_t)width * height * post_format_bytes(format);
+	pool->count++;
+	return rt;
+}
+
+void
+target_pool_release(TargetPool *pool, RenderTarget *rt)
+{
+	(void)pool;
+	rt->in_use = 0;
+}
+
+void
+target_pool_end_frame(TargetPool *pool)
+{
+	for (unsigned i = 0; i < POST_POOL_SIZE; i++) {
+		RenderTarget *rt = &pool->targets[i];
+		if (rt->texture && !rt->in_use && pool->frame - rt->last_used > POST_POOL_MAX_AGE) {
+			delete_target(pool, rt);
+		}
+	}
+	pool->frame++;
+}
+
+void
+target_pool_free(TargetPool *pool)
+{
+	for (unsigned i = 0; i < POST_POOL_SIZE; i++) {
+		if (pool->targets[i].texture) {
+			delete_target(pool, &pool->targets[i]);
+		}
+	}
+	memset(pool, 0, sizeof(TargetPool));
+}
+
+int
+post_gl_init(PostGL *pgl)
+{
+	memset(pgl, 0, sizeof(PostGL));
+	pgl->sharpness = 0.25f;
+
+	pgl->upscale_program = shader_program(upscale_vs, upscale_fs);
+	if (!pgl->upscale_program) {
+		return 0;
+	}
+	glUseProgram(pgl->upscale_program);
+	glUniform1i(glGetUniformLocation(pgl->upscale_program, "source"), 0);
+	pgl->uv_scale_loc = glGetUniformLocation(pgl->upscale_program, "uv_scale");
+	pgl->sharpness_loc = glGetUniformLocation(pgl->upscale_program, "sharpness");
+	glUseProgram(0);
+
+	glGenVertexArrays(1, &pgl->vao);
+	glGenQueries(POST_QUERY_FRAMES * (POST_MAX_PASSES + 1), pgl->queries[0]);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void
+post_gl_free(PostGL *pgl)
+{
+	target_pool_free(&pgl->pool);
+	glDeleteQueries(POST_QUERY_FRAMES * (POST_MAX_PASSES + 1), pgl->queries[0]);
+	glDeleteVertexArrays(1, &pgl->vao);
+	glDeleteProgram(pgl->upscale_program);
+	memset(pgl, 0, sizeof(PostGL));
+}
+
+/*
+ * Report the pass timings of the frame issued POST_QUERY_FRAMES - 1 frames
+ * ago, which the GPU should be done with.
+ */
+static void
+read_timings(PostGL *pgl, unsigned slot)
+{
+	unsigned count = pgl->pass_count[slot];
+	if (count == 0) {
+		return;
+	}
+
+	GLuint available = 0;
+	glGetQueryObjectuiv(pgl->queries[slot][count], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return;
+	}
+
+	GLuint64 start = 0;
+	glGetQueryObjectui64v(pgl->queries[slot][0], GL_QUERY_RESULT, &start);
+	GLuint64 prev = start;
+	for (unsigned i = 0; i < count; i++) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(pgl->queries[slot][i + 1], GL_QUERY_RESULT, &ns);
+		prof_time(pgl->pass_names[slot][i], (ns - prev) * 1e-9);
+		prev = ns;
+	}
+	pgl->gpu_time = (prev - start) * 1e-9;
+	prof_time("gpu frame", pgl->gpu_time);
+}
+
+static void
+bind_output(PostGL *pgl, const PostGraph *graph, const PostPass *p, float scale, unsigned *r_width, unsigned *r_height)
+{
+	if (p->color == POST_BACKBUFFER) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		*r_width = graph->display_width;
+		*r_height = graph->display_height;
+		return;
+	}
+
+	GLuint depth = 0;
+	if (p->depth != POST_NONE) {
+		depth = pgl->slots[graph->targets[p->depth].slot]->texture;
+	}
+
+	if (p->color != POST_NONE) {
+		RenderTarget *rt = pgl->slots[graph->targets[p->color].slot];
+		glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo);
+		if (rt->depth != depth) {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+			rt->depth = depth;
+		}
+		post_target_size(graph, p->color, scale, r_width, r_height);
+	} else {
+		glBindFramebuffer(GL_FRAMEBUFFER, pgl->slots[graph->targets[p->depth].slot]->fbo);
+		post_target_size(graph, p->depth, scale, r_width, r_height);
+	}
+}
+
+int
+post_gl_execute(PostGL *pgl, const PostGraph *graph, float render_scale)
+{
+	if (!graph->compiled) {
+		fprintf(stderr, "render target graph is not compiled\n");
+		return 0;
+	}
+
+	unsigned slot = pgl->frame % POST_QUERY_FRAMES;
+	read_timings(pgl, slot);
+	pgl->pass_count[slot] = 0;
+
+	for (unsigned s = 0; s < graph->slot_count; s++) {
+		const PostSlot *ps = &graph->slots[s];
+		pgl->slots[s] = target_pool_acquire(&pgl->pool, ps->format, ps->width, ps->height);
+		if (!pgl->slots[s]) {
+			while (s-- > 0) {
+				target_pool_release(&pgl->pool, pgl->slots[s]);
+			}
+			return 0;
+		}
+	}
+
+	unsigned executed = 0;
+	for (unsigned i = 0; i < graph->pass_count; i++) {
+		const PostPass *p = &graph->passes[i];
+		if (p->culled) {
+			continue;
+		}
+
+		PostContext ctx;
+		bind_output(pgl, graph, p, render_scale, &ctx.width, &ctx.height);
+		glViewport(0, 0, ctx.width, ctx.height);
+
+		ctx.input_count = p->input_count;
+		for (unsigned j = 0; j < p->input_count; j++) {
+			unsigned width, height;
+			const RenderTarget *rt = pgl->slots[graph->targets[p->inputs[j]].slot];
+			post_target_size(graph, p->inputs[j], render_scale, &width, &height);
+			ctx.inputs[j] = rt->texture;
+			ctx.uv_scale[j][0] = (float)width / rt->width;
+			ctx.uv_scale[j][1] = (float)height / rt->height;
+		}
+
+		glQueryCounter(pgl->queries[slot][executed], GL_TIMESTAMP);
+		pgl->pass_names[slot][executed++] = p->name;
+		p->fn(p->data, &ctx);
+	}
+	glQueryCounter(pgl->queries[slot][executed], GL_TIMESTAMP);
+	pgl->pass_count[slot] = executed;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (unsigned s = 0; s < graph->slot_count; s++) {
+		target_pool_release(&pgl->pool, pgl->slots[s]);
+	}
+	target_pool_end_frame(&pgl->pool);
+
+	prof_count("render scale", render_scale);
+	prof_count("render targets (MiB)", pgl->pool.bytes / MIB);
+	prof_count("saved by aliasing (MiB)", (graph->target_bytes - graph->slot_bytes) / MIB);
+	pgl->frame++;
+	return 1;
+}
+
+void
+post_gl_upscale(void *data, const PostContext *ctx)
+{
+	PostGL *pgl = data;
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glUseProgram(pgl->upscale_program);
+	glUniform2fv(pgl->uv_scale_loc, 1, ctx->uv_scale[0]);
+	glUniform1f(pgl->sharpness_loc, pgl->sharpness);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, ctx->inputs[0]);
+	glBindVertexArray(pgl->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
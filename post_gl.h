@@ -0,0 +1,110 @@
+#pragma once
+
+#include "post.h"
+#include <GL/glew.h>
+
+#define POST_QUERY_FRAMES 3
+#define POST_POOL_SIZE 64
+#define POST_POOL_MAX_AGE 120
+
+/**
+ * RenderTarget - Pooled texture and the framebuffer it is attached to.
+ *
+ * Color targets are attached as the only color attachment, depth targets as
+ * the depth attachment of a framebuffer without color. `depth` is the depth
+ * texture currently attached to a color target's framebuffer.
+ */
+typedef struct RenderTarget {
+	GLuint texture;
+	GLuint fbo;
+	GLuint depth;
+	PostFormat format;
+	unsigned width, height;
+	unsigned long last_used;
+	int in_use;
+} RenderTarget;
+
+/**
+ * TargetPool - Render targets kept across frames, matched by format and size.
+ *
+ * Targets unused for POST_POOL_MAX_AGE frames are freed. Targets never move
+ * within `targets`, so that those acquired stay valid while others are
+ * created or freed; entries without a texture are empty.
+ */
+typedef struct TargetPool {
+	RenderTarget targets[POST_POOL_SIZE];
+	unsigned count;
+	unsigned long frame;
+	size_t bytes;
+} TargetPool;
+
+/**
+ * Take a free target of given format and size out of the pool, creating it
+ * if needed. Returns NULL on failure.
+ */
+RenderTarget*
+target_pool_acquire(TargetPool *pool, PostFormat format, unsigned width, unsigned height);
+
+void
+target_pool_release(TargetPool *pool, RenderTarget *rt);
+
+/**
+ * Free the targets which went unused for too long.
+ */
+void
+target_pool_end_frame(TargetPool *pool);
+
+void
+target_pool_free(TargetPool *pool);
+
+/**
+ * PostGL - Executor of render target graphs.
+ */
+typedef struct PostGL {
+	TargetPool pool;
+	RenderTarget *slots[POST_MAX_TARGETS];
+
+	// timestamps taken before every executed pass and after the last one,
+	// which don't conflict with timer queries issued by the passes
+	GLuint queries[POST_QUERY_FRAMES][POST_MAX_PASSES + 1];
+	const char *pass_names[POST_QUERY_FRAMES][POST_MAX_PASSES];
+	unsigned pass_count[POST_QUERY_FRAMES];
+	unsigned frame;
+	double gpu_time;
+
+	// upscaling pass
+	GLuint vao;
+	GLuint upscale_program;
+	GLint uv_scale_loc;
+	GLint sharpness_loc;
+	float sharpness;
+} PostGL;
+
+/**
+ * Create the timer queries and the upscaling program. Returns 1 on success,
+ * 0 on failure.
+ */
+int
+post_gl_init(PostGL *pgl);
+
+void
+post_gl_free(PostGL *pgl);
+
+/**
+ * Execute a compiled graph at given render scale.
+ *
+ * Reports the GPU time of every pass, the render scale and the memory of the
+ * pooled targets to the profiler, and keeps the GPU time of the last measured
+ * frame in `gpu_time` for post_scaler_update().
+ *
+ * Returns 1 on success, 0 if the targets could not be created.
+ */
+int
+post_gl_execute(PostGL *pgl, const PostGraph *graph, float render_scale);
+
+/**
+ * Pass function upscaling its first input to the output with bilinear
+ * filtering, then sharpening by `sharpness`; `data` is the PostGL.
+ */
+void
+post_gl_upscale(void *data, const PostContext *ctx);
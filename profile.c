@@ -0,0 +1,132 @@
+#include "profile.h"
+#include <SDL.h>
+#include <math.h>
+#include <string.h>
+
+typedef struct ProfEntry {
+	const char *name;
+	int is_time;
+	unsigned samples;
+	double sum, sum_sq, min, max;
+} ProfEntry;
+
+static struct {
+	SDL_mutex *lock;
+	ProfEntry entries[PROF_MAX_ENTRIES];
+	unsigned count;
+	unsigned frames;
+	double last_report;
+	double freq;
+} prof;
+
+int
+prof_init(void)
+{
+	memset(&prof, 0, sizeof(prof));
+	prof.lock = SDL_CreateMutex();
+	prof.freq = (double)SDL_GetPerformanceFrequency();
+	prof.last_report = prof_now();
+	return prof.lock != NULL;
+}
+
+void
+prof_shutdown(void)
+{
+	if (prof.lock) {
+		SDL_DestroyMutex(prof.lock);
+		prof.lock = NULL;
+	}
+}
+
+double
+prof_now(void)
+{
+	return SDL_GetPerformanceCounter() / prof.freq;
+}
+
+static void
+record(const char *name, int is_time, double value)
+{
+	if (!prof.lock) {
+		return;
+	}
+
+	SDL_LockMutex(prof.lock);
+	ProfEntry *e = NULL;
+	for (unsigned i = 0; i < prof.count; i++) {
+		if (strcmp(prof.entries[i].name, name) == 0) {
+			e = &prof.entries[i];
+			break;
+		}
+	}
+	if (!e && prof.count < PROF_MAX_ENTRIES) {
+		e = &prof.entries[prof.count++];
+		e->name = name;
+		e->is_time = is_time;
+	}
+	if (e) {
+		if (e->samples == 0 || value < e->min) {
+			e->min = value;
+		}
+		if (e->samples == 0 || value > e->max) {
+			e->max = value;
+		}
+		e->sum += value;
+		e->sum_sq += value * value;
+		e->samples++;
+	}
+	SDL_UnlockMutex(prof.lock);
+}
+
+void
+prof_time(const char *name, double seconds)
+{
+	record(name, 1, seconds);
+}
+
+void
+prof_count(const char *name, double value)
+{
+	record(name, 0, value);
+}
+
+void
+prof_frame_end(FILE *out)
+{
+	if (!prof.lock) {
+		return;
+	}
+	prof.frames++;
+
+	double now = prof_now();
+	if (now - prof.last_report < PROF_REPORT_INTERVAL) {
+		return;
+	}
+
+	SDL_LockMutex(prof.lock);
+	fprintf(out, "--- %u frames in %.2fs (%.1f fps)\n",
+		prof.frames, now - prof.last_report,
+		prof.frames / (now - prof.last_report));
+	for (unsigned i = 0; i < prof.count; i++) {
+		ProfEntry *e = &prof.entries[i];
+		if (e->samples == 0) {
+			continue;
+		}
+		double avg = e->sum / e->samples;
+		double var = e->sum_sq / e->samples - avg * avg;
+		double sd = var > 0 ? sqrt(var) : 0;
+		if (e->is_time) {
+			fprintf(out, "%-24s avg %8.3fms  sd %8.3fms  min %8.3fms  max %8.3fms\n",
+				e->name, avg * 1e3, sd * 1e3, e->min * 1e3, e->max * 1e3);
+		} else {
+			fprintf(out, "%-24s avg %10.1f  sd %10.1f  min %10.1f  max %10.1f\n",
+				e->name, avg, sd, e->min, e->max);
+		}
+		e->samples = 0;
+		e->sum = e->sum_sq = 0;
+	}
+	SDL_UnlockMutex(prof.lock);
+
+	prof.frames = 0;
+	prof.last_report = now;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdio.h>
+
+/*******************************************************************************
+ * Frame profiler.
+ *
+ * Collects named timings and counters from any thread and prints their
+ * average, standard deviation, minimum and maximum at a fixed interval.
+*******************************************************************************/
+
+#define PROF_MAX_ENTRIES 64
+#define PROF_REPORT_INTERVAL 2.0
+
+int
+prof_init(void);
+
+void
+prof_shutdown(void);
+
+/**
+ * Current time in seconds, from the high resolution performance counter.
+ */
+double
+prof_now(void);
+
+/**
+ * Record a duration in seconds.
+ */
+void
+prof_time(const char *name, double seconds);
+
+/**
+ * Record a counter value.
+ */
+void
+prof_count(const char *name, double value);
+
+/**
+ * Mark the end of a frame, printing the report to `out` once per interval.
+ */
+void
+prof_frame_end(FILE *out);
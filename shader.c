@@ -0,0 +1,111 @@
+#include "shader.h"
+#include <stdio.h>
+
+GLuint
+shader_compile(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	if (!shader) {
+		return 0;
+	}
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "shader compilation failed:\n%s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+static GLuint
+link(GLuint prog)
+{
+	glLinkProgram(prog);
+
+	GLint status;
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		char log[1024];
+		glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+		fprintf(stderr, "program linking failed:\n%s\n", log);
+		glDeleteProgram(prog);
+		return 0;
+	}
+
+	return prog;
+}
+
+GLuint
+shader_link(GLuint vs, GLuint fs)
+{
+	GLuint prog = glCreateProgram();
+	if (prog) {
+		glAttachShader(prog, vs);
+		if (fs) {
+			glAttachShader(prog, fs);
+		}
+		prog = link(prog);
+	}
+
+	glDeleteShader(vs);
+	if (fs) {
+		glDeleteShader(fs);
+	}
+	return prog;
+}
+
+GLuint
+shader_program(const char *vs_source, const char *fs_source)
+{
+	GLuint vs = shader_compile(GL_VERTEX_SHADER, vs_source);
+	GLuint fs = 0;
+	if (!vs) {
+		return 0;
+	}
+	if (fs_source && !(fs = shader_compile(GL_FRAGMENT_SHADER, fs_source))) {
+		glDeleteShader(vs);
+		return 0;
+	}
+	return shader_link(vs, fs);
+}
+
+GLuint
+shader_feedback_program(
+	const char *vs_source,
+	const char *gs_source,
+	const char **varyings,
+	unsigned count
+) {
+	GLuint vs = shader_compile(GL_VERTEX_SHADER, vs_source);
+	GLuint gs = 0;
+	if (!vs) {
+		return 0;
+	}
+	if (gs_source && !(gs = shader_compile(GL_GEOMETRY_SHADER, gs_source))) {
+		glDeleteShader(vs);
+		return 0;
+	}
+
+	GLuint prog = glCreateProgram();
+	if (prog) {
+		glAttachShader(prog, vs);
+		if (gs) {
+			glAttachShader(prog, gs);
+		}
+		glTransformFeedbackVaryings(prog, count, varyings, GL_INTERLEAVED_ATTRIBS);
+		prog = link(prog);
+	}
+
+	glDeleteShader(vs);
+	if (gs) {
+		glDeleteShader(gs);
+	}
+	return prog;
+}
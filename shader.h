@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+
+/**
+ * Compile a shader of given type from source.
+ *
+ * Prints the info log and returns 0 on failure.
+ */
+GLuint
+shader_compile(GLenum type, const char *source);
+
+/**
+ * Compile and link a program out of a vertex and a fragment shader.
+ *
+ * `fs_source` may be NULL for programs which only feed transform feedback or
+ * the depth buffer. Returns 0 on failure.
+ */
+GLuint
+shader_program(const char *vs_source, const char *fs_source);
+
+/**
+ * Link a program out of already compiled shaders, deleting them afterwards.
+ */
+GLuint
+shader_link(GLuint vs, GLuint fs);
+
+/**
+ * Compile and link a program capturing `varyings` of the last vertex
+ * processing stage with transform feedback, interleaved in one buffer.
+ *
+ * `gs_source` may be NULL. Returns 0 on failure.
+ */
+GLuint
+shader_feedback_program(
+	const char *vs_source,
+	const char *gs_source,
+	const char **varyings,
+	unsigned count
+);
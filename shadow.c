@@ -0,0 +1,287 @@
+#include "shadow.h"
+#include "job.h"
+#include "mem.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+void
+shadow_splits(float near, float far, unsigned count, float lambda, float *r_splits)
+{
+	for (unsigned i = 0; i <= count; i++) {
+		float t = (float)i / count;
+		float log_split = near * powf(far / near, t);
+		float uniform_split = near + (far - near) * t;
+		r_splits[i] = lambda * log_split + (1.0f - lambda) * uniform_split;
+	}
+	r_splits[0] = near;
+	r_splits[count] = far;
+}
+
+int
+shadow_init(
+	ShadowMap *sm,
+	unsigned count,
+	unsigned resolution,
+	float near,
+	float far,
+	float lambda,
+	unsigned cache_first
+) {
+	memset(sm, 0, sizeof(ShadowMap));
+	if (count == 0 || count > SHADOW_MAX_CASCADES || resolution == 0 || near <= 0 || far <= near) {
+		fprintf(stderr, "invalid shadow cascade setup\n");
+		return 0;
+	}
+
+	sm->count = count;
+	sm->cache_first = cache_first;
+	sm->resolution = resolution;
+	sm->lambda = lambda;
+
+	float splits[SHADOW_MAX_CASCADES + 1];
+	shadow_splits(near, far, count, lambda, splits);
+	for (unsigned i = 0; i < count; i++) {
+		sm->cascades[i].split_near = splits[i];
+		sm->cascades[i].split_far = splits[i + 1];
+		sm->cascades[i].cached = i >= cache_first;
+	}
+
+	Vec dir = vec(0, -1, 0, 0);
+	shadow_set_light(sm, &dir);
+
+	return 1;
+}
+
+void
+shadow_free(ShadowMap *sm)
+{
+	memset(sm, 0, sizeof(ShadowMap));
+}
+
+void
+shadow_set_light(ShadowMap *sm, const Vec *dir)
+{
+	Vec d = *dir;
+	d.data[3] = 0;
+	vec_norm(&d);
+	if (memcmp(&d, &sm->light_dir, sizeof(Vec)) == 0) {
+		return;
+	}
+	sm->light_dir = d;
+
+	// rotation-only view looking along the light direction
+	Vec eye = vec(0, 0, 0, 1);
+	Vec up = fabsf(d.data[1]) > 0.99f ? vec(0, 0, 1, 0) : vec(0, 1, 0, 0);
+	mat_lookatv(&sm->light_view, &eye, &d, &up);
+	sm->generation++;
+}
+
+void
+shadow_static_changed(ShadowMap *sm)
+{
+	sm->generation++;
+}
+
+/*
+ * Bounding sphere of the frustum slice between depths `a` and `b`, given the
+ * squared spread `k2` of the frustum corners per unit of depth.
+ */
+static void
+slice_sphere(float a, float b, float k2, float *r_depth, float *r_radius)
+{
+	float c = 0.5f * (a + b) * (1.0f + k2);
+	if (c > b) {
+		c = b;
+	}
+	float far_r = (b - c) * (b - c) + b * b * k2;
+	float near_r = (c - a) * (c - a) + a * a * k2;
+	*r_depth = c;
+	*r_radius = sqrtf(far_r > near_r ? far_r : near_r);
+}
+
+static double
+snap(double x, double texel)
+{
+	return floor(x / texel + 0.5) * texel;
+}
+
+typedef struct FitJob {
+	ShadowMap *sm;
+	const ShadowCaster *casters;
+	unsigned count;
+
+	// light-space caster bounds, in SoA layout
+	float *lx, *ly, *lz;
+	float center[SHADOW_MAX_CASCADES][3];
+	float extent[SHADOW_MAX_CASCADES];
+} FitJob;
+
+static void
+transform_casters(void *data, unsigned begin, unsigned end)
+{
+	FitJob *job = data;
+	const float *v = job->sm->light_view.data;
+
+	for (unsigned i = begin; i < end; i++) {
+		const float *p = job->casters[i].center;
+		job->lx[i] = v[0] * p[0] + v[1] * p[1] + v[2] * p[2];
+		job->ly[i] = v[4] * p[0] + v[5] * p[1] + v[6] * p[2];
+		job->lz[i] = v[8] * p[0] + v[9] * p[1] + v[10] * p[2];
+	}
+}
+
+static void
+cull_cascades(void *data, unsigned begin, unsigned end)
+{
+	FitJob *job = data;
+	ShadowMap *sm = job->sm;
+
+	for (unsigned i = begin; i < end; i++) {
+		ShadowCascade *c = &sm->cascades[i];
+		int want_statics = !c->cached || c->static_dirty;
+		float cx = job->center[i][0], cy = job->center[i][1], cz = job->center[i][2];
+		float extent = job->extent[i];
+
+		c->static_count = 0;
+		c->dynamic_count = 0;
+		for (unsigned k = 0; k < job->count; k++) {
+			// casters in front of the cascade along the light are kept,
+			// their depth is clamped to the near plane
+			float r = job->casters[k].radius + extent;
+			int visible = fabsf(job->lx[k] - cx) <= r &&
+			              fabsf(job->ly[k] - cy) <= r &&
+			              job->lz[k] + r >= cz;
+			if (!visible) {
+				continue;
+			}
+			if (!job->casters[k].is_static) {
+				c->dynamics[c->dynamic_count++] = k;
+			} else if (want_statics) {
+				c->statics[c->static_count++] = k;
+			}
+		}
+	}
+}
+
+int
+shadow_fit(
+	ShadowMap *sm,
+	const Mat *view,
+	const Mat *proj,
+	const DVec *origin,
+	const ShadowCaster *casters,
+	unsigned count
+) {
+	// lists sized for every caster, as any of them may be visible
+	Arena *frame = mem_frame();
+	for (unsigned i = 0; i < sm->count; i++) {
+		ShadowCascade *c = &sm->cascades[i];
+		c->statics = arena_alloc(frame, count * sizeof(unsigned), MEM_ALIGN_SIMD);
+		c->dynamics = arena_alloc(frame, count * sizeof(unsigned), MEM_ALIGN_SIMD);
+		c->static_count = 0;
+		c->dynamic_count = 0;
+		if (!c->statics || !c->dynamics) {
+			return 0;
+		}
+	}
+
+	Arena *scratch = mem_thread();
+	if (!scratch) {
+		return 0;
+	}
+	size_t mark = arena_mark(scratch);
+	FitJob job = { sm, casters, count };
+	job.lx = arena_alloc(scratch, count * sizeof(float), MEM_ALIGN_CACHE);
+	job.ly = arena_alloc(scratch, count * sizeof(float), MEM_ALIGN_CACHE);
+	job.lz = arena_alloc(scratch, count * sizeof(float), MEM_ALIGN_CACHE);
+	if (!job.lx || !job.ly || !job.lz) {
+		arena_rewind(scratch, mark);
+		return 0;
+	}
+
+	Mat inv_view = *view;
+	mat_inverse(&inv_view, &inv_view);
+	const float *lv = sm->light_view.data;
+
+	// light-space position of the space origin, in double precision so that
+	// texels are snapped on a grid fixed in the world
+	double lo[3] = { 0, 0, 0 };
+	if (origin) {
+		for (unsigned r = 0; r < 3; r++) {
+			lo[r] = lv[r * 4] * origin->data[0] +
+			        lv[r * 4 + 1] * origin->data[1] +
+			        lv[r * 4 + 2] * origin->data[2];
+		}
+	}
+
+	float tx = 1.0f / proj->data[0];
+	float ty = 1.0f / proj->data[5];
+	float k2 = tx * tx + ty * ty;
+
+	sm->skipped = 0;
+	for (unsigned i = 0; i < sm->count; i++) {
+		ShadowCascade *c = &sm->cascades[i];
+
+		float depth;
+		slice_sphere(c->split_near, c->split_far, k2, &depth, &c->radius);
+
+		// sphere center from view space to light space
+		Vec center_view = vec(0, 0, -depth, 1), center;
+		mat_mulv(&inv_view, &center_view, &center);
+		double w[3];
+		for (unsigned r = 0; r < 3; r++) {
+			w[r] = lo[r] + lv[r * 4] * center.data[0] +
+			               lv[r * 4 + 1] * center.data[1] +
+			               lv[r * 4 + 2] * center.data[2];
+		}
+
+		float extent = c->radius;
+		if (c->cached) {
+			// keep the cached region while the sphere stays inside it
+			extent = c->radius * SHADOW_CACHE_PADDING;
+			double slack = extent - c->radius;
+			int inside = c->generation == sm->generation &&
+			             fabs(w[0] - c->cache_center[0]) <= slack &&
+			             fabs(w[1] - c->cache_center[1]) <= slack &&
+			             fabs(w[2] - c->cache_center[2]) <= slack;
+			if (inside) {
+				c->static_dirty = 0;
+				sm->skipped++;
+			} else {
+				c->texel = 2.0f * extent / sm->resolution;
+				c->cache_center[0] = snap(w[0], c->texel);
+				c->cache_center[1] = snap(w[1], c->texel);
+				c->cache_center[2] = w[2];
+				c->generation = sm->generation;
+				c->static_dirty = 1;
+			}
+			w[0] = c->cache_center[0];
+			w[1] = c->cache_center[1];
+			w[2] = c->cache_center[2];
+		} else {
+			c->texel = 2.0f * extent / sm->resolution;
+			w[0] = snap(w[0], c->texel);
+			w[1] = snap(w[1], c->texel);
+		}
+
+		// back to the coordinate space of the camera
+		float cx = w[0] - lo[0], cy = w[1] - lo[1], cz = w[2] - lo[2];
+		job.center[i][0] = cx;
+		job.center[i][1] = cy;
+		job.center[i][2] = cz;
+		job.extent[i] = extent;
+
+		// the light looks down -z, so depths are negated light-space z
+		Mat ortho;
+		mat_ortho(&ortho, cx - extent, cx + extent, cy + extent, cy - extent, -(cz + extent), -(cz - extent));
+		mat_mul(&ortho, &sm->light_view, &c->view_proj);
+	}
+	sm->total_skipped += sm->skipped;
+
+	job_parallel_for(count, 256, transform_casters, &job);
+	job_parallel_for(sm->count, 1, cull_cascades, &job);
+
+	arena_rewind(scratch, mark);
+	return 1;
+}
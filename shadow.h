@@ -0,0 +1,139 @@
+#pragma once
+
+#include "matlib.h"
+
+/*******************************************************************************
+ * Cascaded shadow maps for a directional light.
+ *
+ * The view frustum is split in depth and each split is covered by its own
+ * orthographic shadow map. Cascades are fitted to the bounding sphere of their
+ * split, so that their size does not change when the camera rotates, and
+ * their origin is snapped to whole shadow map texels in world space, so that
+ * they do not shimmer when it moves.
+ *
+ * The far cascades keep the depth of static casters in a cache which is only
+ * re-rendered when the light or the static geometry changes, or when the
+ * camera moves out of the padded region it covers. Dynamic casters are drawn
+ * over a copy of it every frame.
+*******************************************************************************/
+
+#define SHADOW_MAX_CASCADES 4
+#define SHADOW_CACHE_PADDING 1.5f
+
+/**
+ * ShadowCaster - Bounding sphere of an object casting shadows.
+ */
+typedef struct ShadowCaster {
+	float center[3];
+	float radius;
+	int is_static;
+} ShadowCaster;
+
+/**
+ * ShadowCascade - Fitted cascade and the casters to draw into it this frame.
+ */
+typedef struct ShadowCascade {
+	float split_near, split_far;
+	float radius;
+	float texel;
+	Mat view_proj;
+
+	// cached cascades: world-anchored light-space center of the cached
+	// region, whether its static depth must be re-rendered
+	int cached;
+	int static_dirty;
+	unsigned generation;
+	double cache_center[3];
+
+	// caster indices, statics are only listed when they have to be drawn;
+	// allocated from the frame arena, valid until the end of the next frame
+	unsigned *statics;
+	unsigned static_count;
+	unsigned *dynamics;
+	unsigned dynamic_count;
+} ShadowCascade;
+
+/**
+ * ShadowMap - Cascade setup and per-frame fitting state.
+ */
+typedef struct ShadowMap {
+	unsigned count;
+	unsigned cache_first;
+	unsigned resolution;
+	float lambda;
+	Vec light_dir;
+	Mat light_view;
+	unsigned generation;
+	ShadowCascade cascades[SHADOW_MAX_CASCADES];
+
+	// cached cascades which did not need their static depth re-rendered
+	unsigned skipped;
+	unsigned long total_skipped;
+} ShadowMap;
+
+/**
+ * Compute practical split distances between `near` and `far`, blending the
+ * logarithmic and uniform schemes with `lambda` (1 is fully logarithmic).
+ *
+ * Writes `count + 1` distances to `r_splits`.
+ */
+void
+shadow_splits(float near, float far, unsigned count, float lambda, float *r_splits);
+
+/**
+ * Set up `count` cascades of `resolution` texels for the range of a
+ * perspective projection built with mat_persp(). Cascades starting from
+ * `cache_first` cache their static casters.
+ *
+ * Returns 1 on success, 0 on invalid parameters.
+ */
+int
+shadow_init(
+	ShadowMap *sm,
+	unsigned count,
+	unsigned resolution,
+	float near,
+	float far,
+	float lambda,
+	unsigned cache_first
+);
+
+void
+shadow_free(ShadowMap *sm);
+
+/**
+ * Set the direction the light travels in, invalidating the caches when it
+ * changes.
+ */
+void
+shadow_set_light(ShadowMap *sm, const Vec *dir);
+
+/**
+ * Invalidate the caches after static casters were added, moved or removed.
+ */
+void
+shadow_static_changed(ShadowMap *sm);
+
+/**
+ * Fit the cascades to the view frustum and cull the casters of each of them,
+ * on the worker threads.
+ *
+ * `view` and `proj` are the camera matrices, `origin` is the world position of
+ * the coordinate space the view and casters are expressed in, used to anchor
+ * texel snapping for camera-relative rendering; it may be NULL when they are in
+ * world space.
+ *
+ * The caster lists are allocated from mem_frame(), the light-space caster
+ * bounds from the scratch arena of the calling thread.
+ *
+ * Returns 1 on success, 0 if an arena is out of space.
+ */
+int
+shadow_fit(
+	ShadowMap *sm,
+	const Mat *view,
+	const Mat *proj,
+	const DVec *origin,
+	const ShadowCaster *casters,
+	unsigned count
+);
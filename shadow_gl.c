@@ -0,0 +1,188 @@
+#include "shadow_gl.h"
+#include "profile.h"
+#include <string.h>
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+static const char *cascade_names[SHADOW_MAX_CASCADES] = {
+	"shadow cascade 0",
+	"shadow cascade 1",
+	"shadow cascade 2",
+	"shadow cascade 3",
+};
+
+const char *shadow_gl_fs =
+	"uniform sampler2DArrayShadow shadow_map;\n"
+	"uniform mat4 shadow_matrices[" XSTR(SHADOW_MAX_CASCADES) "];\n"
+	"uniform float shadow_splits[" XSTR(SHADOW_MAX_CASCADES) "];\n"
+	"uniform int shadow_count;\n"
+	"float shadow_factor(vec3 pos, float depth) {\n"
+	"	int cascade = 0;\n"
+	"	while (cascade < shadow_count - 1 && depth > shadow_splits[cascade]) {\n"
+	"		cascade++;\n"
+	"	}\n"
+	"	vec4 p = shadow_matrices[cascade] * vec4(pos, 1.0);\n"
+	"	p.xyz = p.xyz * 0.5 + 0.5;\n"
+	"	return texture(shadow_map, vec4(p.xy, float(cascade), p.z));\n"
+	"}\n";
+
+static GLuint
+depth_array(unsigned resolution, unsigned layers)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+	glTexImage3D(
+		GL_TEXTURE_2D_ARRAY,
+		0,
+		GL_DEPTH_COMPONENT32F,
+		resolution,
+		resolution,
+		layers,
+		0,
+		GL_DEPTH_COMPONENT,
+		GL_FLOAT,
+		NULL
+	);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return tex;
+}
+
+int
+shadow_gl_init(ShadowTargets *st, const ShadowMap *sm)
+{
+	memset(st, 0, sizeof(ShadowTargets));
+	st->resolution = sm->resolution;
+	st->count = sm->count;
+
+	st->depth = depth_array(sm->resolution, sm->count);
+	if (sm->cache_first < sm->count) {
+		st->cache = depth_array(sm->resolution, sm->count - sm->cache_first);
+	}
+	glGenFramebuffers(2, st->fbo);
+	for (unsigned i = 0; i < 2; i++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, st->fbo[i]);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glGenQueries(SHADOW_MAX_CASCADES * SHADOW_QUERY_FRAMES, st->queries[0]);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+void
+shadow_gl_free(ShadowTargets *st)
+{
+	glDeleteQueries(SHADOW_MAX_CASCADES * SHADOW_QUERY_FRAMES, st->queries[0]);
+	glDeleteFramebuffers(2, st->fbo);
+	glDeleteTextures(1, &st->cache);
+	glDeleteTextures(1, &st->depth);
+	memset(st, 0, sizeof(ShadowTargets));
+}
+
+static void
+target(GLenum fb, GLuint fbo, GLuint tex, unsigned layer)
+{
+	glBindFramebuffer(fb, fbo);
+	glFramebufferTextureLayer(fb, GL_DEPTH_ATTACHMENT, tex, 0, layer);
+}
+
+void
+shadow_gl_render(ShadowTargets *st, const ShadowMap *sm, ShadowDrawFunc draw, void *data)
+{
+	// results of the queries issued SHADOW_QUERY_FRAMES - 1 frames ago,
+	// which the GPU should be done with
+	unsigned slot = st->frame % SHADOW_QUERY_FRAMES;
+	if (st->frame >= SHADOW_QUERY_FRAMES) {
+		for (unsigned i = 0; i < st->count; i++) {
+			GLuint available = 0;
+			glGetQueryObjectuiv(st->queries[i][slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 ns = 0;
+				glGetQueryObjectui64v(st->queries[i][slot], GL_QUERY_RESULT, &ns);
+				prof_time(cascade_names[i], ns * 1e-9);
+			}
+		}
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, st->resolution, st->resolution);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	// clamp casters in front of the near plane instead of clipping them,
+	// and offset depth against acne
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.5f, 2.0f);
+
+	for (unsigned i = 0; i < sm->count; i++) {
+		const ShadowCascade *c = &sm->cascades[i];
+		glBeginQuery(GL_TIME_ELAPSED, st->queries[i][slot]);
+
+		if (c->cached) {
+			unsigned layer = i - sm->cache_first;
+			if (c->static_dirty) {
+				target(GL_FRAMEBUFFER, st->fbo[0], st->cache, layer);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				draw(data, &c->view_proj, c->statics, c->static_count);
+			}
+			target(GL_READ_FRAMEBUFFER, st->fbo[1], st->cache, layer);
+			target(GL_DRAW_FRAMEBUFFER, st->fbo[0], st->depth, i);
+			glBlitFramebuffer(
+				0, 0, st->resolution, st->resolution,
+				0, 0, st->resolution, st->resolution,
+				GL_DEPTH_BUFFER_BIT,
+				GL_NEAREST
+			);
+			glBindFramebuffer(GL_FRAMEBUFFER, st->fbo[0]);
+		} else {
+			target(GL_FRAMEBUFFER, st->fbo[0], st->depth, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			draw(data, &c->view_proj, c->statics, c->static_count);
+		}
+		draw(data, &c->view_proj, c->dynamics, c->dynamic_count);
+
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	prof_count("shadow cache skips", sm->skipped);
+	st->frame++;
+}
+
+void
+shadow_gl_uniforms(const ShadowTargets *st, const ShadowMap *sm, GLuint program)
+{
+	float splits[SHADOW_MAX_CASCADES];
+	Mat matrices[SHADOW_MAX_CASCADES];
+	for (unsigned i = 0; i < sm->count; i++) {
+		splits[i] = sm->cascades[i].split_far;
+		matrices[i] = sm->cascades[i].view_proj;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, st->depth);
+	glActiveTexture(GL_TEXTURE0);
+
+	// matlib matrices are row-major
+	glUniform1i(glGetUniformLocation(program, "shadow_map"), SHADOW_MAP_UNIT);
+	glUniformMatrix4fv(glGetUniformLocation(program, "shadow_matrices"), sm->count, GL_TRUE, matrices[0].data);
+	glUniform1fv(glGetUniformLocation(program, "shadow_splits"), sm->count, splits);
+	glUniform1i(glGetUniformLocation(program, "shadow_count"), sm->count);
+}
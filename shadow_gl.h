@@ -0,0 +1,69 @@
+#pragma once
+
+#include "shadow.h"
+#include <GL/glew.h>
+
+#define SHADOW_QUERY_FRAMES 3
+#define SHADOW_MAP_UNIT 7
+
+/**
+ * Draw the casters listed in `indices` with given light view-projection.
+ *
+ * Called with the shadow framebuffer bound and depth-only state set up.
+ */
+typedef void (*ShadowDrawFunc)(
+	void *data,
+	const Mat *view_proj,
+	const unsigned *indices,
+	unsigned count
+);
+
+/**
+ * ShadowTargets - Depth textures of the cascades and of the static caster
+ * caches, with the timer queries measuring each cascade.
+ */
+typedef struct ShadowTargets {
+	GLuint depth;
+	GLuint cache;
+	GLuint fbo[2];
+	GLuint queries[SHADOW_MAX_CASCADES][SHADOW_QUERY_FRAMES];
+	unsigned frame;
+	unsigned resolution;
+	unsigned count;
+} ShadowTargets;
+
+/**
+ * GLSL snippet declaring the cascade lookup.
+ *
+ * Defines `float shadow_factor(vec3 pos, float depth)` returning the lit
+ * fraction of a point, given in the space the cascades were fitted in, at
+ * positive view-space `depth`. Set its uniforms with shadow_gl_uniforms().
+ */
+extern const char *shadow_gl_fs;
+
+/**
+ * Create the depth textures of `sm`. Returns 1 on success, 0 on failure.
+ */
+int
+shadow_gl_init(ShadowTargets *st, const ShadowMap *sm);
+
+void
+shadow_gl_free(ShadowTargets *st);
+
+/**
+ * Render the cascades fitted by shadow_fit().
+ *
+ * Static casters of cached cascades are only drawn when their cache is dirty,
+ * otherwise the cached depth is copied before drawing the dynamic casters.
+ * Reports GPU time per cascade and the number of skipped re-renders to the
+ * profiler.
+ */
+void
+shadow_gl_render(ShadowTargets *st, const ShadowMap *sm, ShadowDrawFunc draw, void *data);
+
+/**
+ * Bind the cascade depth texture to SHADOW_MAP_UNIT and set the lookup
+ * uniforms of `program`, which must be in use.
+ */
+void
+shadow_gl_uniforms(const ShadowTargets *st, const ShadowMap *sm, GLuint program);
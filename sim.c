@@ -0,0 +1,156 @@
+#include "sim.h"
+#include "job.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define UPDATE_GRAIN 64
+
+static void
+init_objects(Sim *sim)
+{
+	sim->object_count = SIM_OBJECT_COUNT;
+	for (unsigned i = 0; i < sim->object_count; i++) {
+		SimObject *obj = &sim->objects[i];
+		float a = i * 0.1f;
+		obj->pos = dvec((i % 32) - 16.0, (i / 32) % 32 - 16.0, -40.0, 1);
+		obj->vel = dvec(0, 0, 0, 0);
+		obj->rot = qtr(1, 0, 0, 0);
+		obj->axis = vec(sinf(a), cosf(a), 0.5f, 0);
+		vec_norm(&obj->axis);
+		obj->spin = 0.5f + (i % 7) * 0.25f;
+	}
+	memcpy(sim->prev, sim->objects, sizeof(SimObject) * sim->object_count);
+}
+
+static void
+handle_input(Sim *sim, const InputEvent *e)
+{
+	if (e->event.type == SDL_KEYDOWN && e->event.key.keysym.sym == SDLK_SPACE) {
+		sim->paused = !sim->paused;
+	}
+	if (e->time > sim->input_time) {
+		sim->input_time = e->time;
+	}
+}
+
+static void
+update_job(void *data, unsigned begin, unsigned end)
+{
+	Sim *sim = data;
+	const float dt = (float)sim->step;
+	for (unsigned i = begin; i < end; i++) {
+		SimObject *obj = &sim->objects[i];
+		DVec dp;
+		dvec_mulf(&obj->vel, sim->step, &dp);
+		dvec_iadd(&obj->pos, &dp);
+		qtr_rotatev(&obj->rot, &obj->axis, obj->spin * dt);
+		qtr_norm(&obj->rot);
+	}
+}
+
+static void
+step(Sim *sim)
+{
+	InputEvent e;
+	while (input_pop(&sim->input, &e)) {
+		handle_input(sim, &e);
+	}
+
+	memcpy(sim->prev, sim->objects, sizeof(SimObject) * sim->object_count);
+	if (!sim->paused) {
+		job_parallel_for(sim->object_count, UPDATE_GRAIN, update_job, sim);
+	}
+	sim->time += sim->step;
+	sim->tick++;
+}
+
+static void
+publish(Sim *sim)
+{
+	Frame *frame = frame_back(sim->exchange);
+	frame->tick = sim->tick;
+	frame->time = sim->time;
+	frame->step = sim->step;
+	frame->input_time = sim->input_time;
+	frame->object_count = sim->object_count;
+	for (unsigned i = 0; i < sim->object_count; i++) {
+		FrameObject *fo = &frame->objects[i];
+		fo->prev_pos = sim->prev[i].pos;
+		fo->pos = sim->objects[i].pos;
+		fo->prev_rot = sim->prev[i].rot;
+		fo->rot = sim->objects[i].rot;
+		fo->scale = dvec(0.4, 0.4, 0.4, 0);
+		fo->mesh = 0;
+	}
+	frame_publish(sim->exchange);
+}
+
+static int
+run(void *data)
+{
+	Sim *sim = data;
+
+	// simulation time runs on the same clock as the render thread, so that
+	// snapshots can be interpolated against the time they are drawn at
+	sim->time = prof_now();
+	publish(sim);
+
+	while (!SDL_AtomicGet(&sim->quit)) {
+		double now = prof_now();
+		if (now < sim->time + sim->step) {
+			// sleep the whole milliseconds until the next step is due,
+			// rounding down to absorb the scheduler wake-up latency, and
+			// only spin through the last fraction of a millisecond
+			double wait = sim->time + sim->step - now;
+			if (wait >= 0.001) {
+				SDL_Delay((Uint32)(wait * 1000));
+			}
+			continue;
+		}
+
+		double t = prof_now();
+		unsigned steps = 0;
+		while (now >= sim->time + sim->step && steps < 8) {
+			step(sim);
+			steps++;
+		}
+		// drop the time we could not catch up with
+		if (now >= sim->time + sim->step) {
+			sim->time = now;
+		}
+		publish(sim);
+		prof_time("sim", prof_now() - t);
+	}
+
+	return 0;
+}
+
+Sim*
+sim_start(FrameExchange *exchange, double step)
+{
+	Sim *sim = calloc(1, sizeof(Sim));
+	if (!sim) {
+		return NULL;
+	}
+	sim->exchange = exchange;
+	sim->step = step;
+	init_objects(sim);
+
+	sim->thread = SDL_CreateThread(run, "simulation", sim);
+	if (!sim->thread) {
+		free(sim);
+		return NULL;
+	}
+	return sim;
+}
+
+void
+sim_stop(Sim *sim)
+{
+	if (sim) {
+		SDL_AtomicSet(&sim->quit, 1);
+		SDL_WaitThread(sim->thread, NULL);
+		free(sim);
+	}
+}
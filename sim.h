@@ -0,0 +1,52 @@
+#pragma once
+
+#include "frame.h"
+
+#define SIM_STEP (1.0 / 120.0)
+#define SIM_OBJECT_COUNT 1024
+
+/**
+ * SimObject - Simulated object state.
+ */
+typedef struct SimObject {
+	DVec pos;
+	DVec vel;
+	Qtr rot;
+	Vec axis;
+	float spin;
+} SimObject;
+
+/**
+ * Sim - Fixed time step simulation running on its own thread.
+ *
+ * Input events are fed through `input`; after every batch of steps the
+ * simulation publishes a snapshot to the frame exchange.
+ */
+typedef struct Sim {
+	SDL_Thread *thread;
+	SDL_atomic_t quit;
+	FrameExchange *exchange;
+	InputQueue input;
+
+	// owned by the simulation thread
+	double step;
+	double time;
+	unsigned long tick;
+	double input_time;
+	int paused;
+	unsigned object_count;
+	SimObject objects[SIM_OBJECT_COUNT];
+	SimObject prev[SIM_OBJECT_COUNT];
+} Sim;
+
+/**
+ * Create the simulation and start its thread. Returns NULL on failure.
+ */
+Sim*
+sim_start(FrameExchange *exchange, double step);
+
+/**
+ * Stop the simulation thread and free the simulation.
+ */
+void
+sim_stop(Sim *sim);
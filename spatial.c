@@ -0,0 +1,544 @@
+#include "spatial.h"
+#include "job.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_SIZE 16384
+#define PAIR_CHUNK_BUCKETS 1024
+#define MIN_BUCKET_BITS 10
+
+/*
+ * Hash of a cell. Blocks of 4x4x4 cells are hashed as a whole and the cells
+ * of a block map to consecutive buckets, so that neighborhood queries mostly
+ * stay within a few cache lines.
+ */
+static inline uint32_t
+hash_cell(int x, int y, int z, unsigned bits)
+{
+	uint32_t h = (uint32_t)(x >> 2) * 73856093u ^
+	             (uint32_t)(y >> 2) * 19349663u ^
+	             (uint32_t)(z >> 2) * 83492791u;
+	h = (h * 0x9e3779b1u) >> (32 - bits + 6);
+	return (h << 6 | (x & 3) << 4 | (y & 3) << 2 | (z & 3)) & ((1u << bits) - 1);
+}
+
+static inline int
+cell(const SpatialGrid *grid, float x)
+{
+	// floor without a library call
+	float f = x * grid->inv_cell_size;
+	int i = (int)f;
+	return i - (f < i);
+}
+
+/*
+ * Squared distance from a point to the closest point of a cell.
+ */
+static inline float
+cell_dist2(const SpatialGrid *grid, int x, int y, int z, float px, float py, float pz)
+{
+	const float size = grid->cell_size;
+	float dx = x * size - px, dy = y * size - py, dz = z * size - pz;
+	dx = dx > 0 ? dx : (dx + size < 0 ? -(dx + size) : 0);
+	dy = dy > 0 ? dy : (dy + size < 0 ? -(dy + size) : 0);
+	dz = dz > 0 ? dz : (dz + size < 0 ? -(dz + size) : 0);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+int
+spatial_init(SpatialGrid *grid, float cell_size)
+{
+	memset(grid, 0, sizeof(SpatialGrid));
+	if (!(cell_size > 0)) {
+		fprintf(stderr, "invalid spatial grid cell size %g\n", cell_size);
+		return 0;
+	}
+	grid->cell_size = cell_size;
+	grid->inv_cell_size = 1.0f / cell_size;
+	return 1;
+}
+
+static void
+free_points(SpatialGrid *grid)
+{
+	free(grid->x);
+	free(grid->y);
+	free(grid->z);
+	free(grid->ids);
+	free(grid->keys);
+	free(grid->order);
+	grid->x = grid->y = grid->z = NULL;
+	grid->ids = grid->keys = grid->order = NULL;
+	grid->capacity = 0;
+}
+
+void
+spatial_free(SpatialGrid *grid)
+{
+	free_points(grid);
+	free(grid->starts);
+	free(grid->cursors);
+	free(grid->pair_offsets);
+	free(grid->histograms);
+	memset(grid, 0, sizeof(SpatialGrid));
+}
+
+static int
+reserve(SpatialGrid *grid, unsigned count)
+{
+	if (count > grid->capacity) {
+		free_points(grid);
+		grid->x = malloc(count * sizeof(float));
+		grid->y = malloc(count * sizeof(float));
+		grid->z = malloc(count * sizeof(float));
+		grid->ids = malloc(count * sizeof(uint32_t));
+		grid->keys = malloc(count * sizeof(uint32_t));
+		grid->order = malloc(count * sizeof(uint32_t));
+		if (!grid->x || !grid->y || !grid->z || !grid->ids || !grid->keys || !grid->order) {
+			free_points(grid);
+			return 0;
+		}
+		grid->capacity = count;
+	}
+
+	// about one bucket per point
+	unsigned bits = MIN_BUCKET_BITS;
+	while (bits < 31 && (1u << bits) < count) {
+		bits++;
+	}
+	if (bits != grid->bucket_bits || !grid->starts) {
+		unsigned pair_chunk_count = ((1u << bits) + PAIR_CHUNK_BUCKETS - 1) / PAIR_CHUNK_BUCKETS;
+		free(grid->starts);
+		free(grid->cursors);
+		free(grid->pair_offsets);
+		grid->starts = malloc(((1u << bits) + 1) * sizeof(uint32_t));
+		grid->cursors = malloc((1u << bits) * sizeof(uint32_t));
+		grid->pair_offsets = malloc(pair_chunk_count * sizeof(uint32_t));
+		if (!grid->starts || !grid->cursors || !grid->pair_offsets) {
+			free(grid->starts);
+			free(grid->cursors);
+			free(grid->pair_offsets);
+			grid->starts = grid->cursors = grid->pair_offsets = NULL;
+			grid->bucket_bits = 0;
+			return 0;
+		}
+		grid->bucket_bits = bits;
+	}
+
+	unsigned chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	if (chunks > grid->chunk_capacity) {
+		free(grid->histograms);
+		grid->histograms = malloc(chunks * SPATIAL_PARTITIONS * sizeof(uint32_t));
+		if (!grid->histograms) {
+			grid->chunk_capacity = 0;
+			return 0;
+		}
+		grid->chunk_capacity = chunks;
+	}
+
+	return 1;
+}
+
+typedef struct BuildJob {
+	SpatialGrid *grid;
+	const Vec *positions;
+	unsigned count;
+} BuildJob;
+
+/*
+ * Compute the bucket of every point of a chunk and the histogram of their
+ * partitions.
+ */
+static void
+key_chunks(void *data, unsigned begin, unsigned end)
+{
+	BuildJob *job = data;
+	SpatialGrid *grid = job->grid;
+	const unsigned bits = grid->bucket_bits;
+	const unsigned shift = bits - 8;
+
+	for (unsigned c = begin; c < end; c++) {
+		uint32_t *hist = grid->histograms + c * SPATIAL_PARTITIONS;
+		memset(hist, 0, SPATIAL_PARTITIONS * sizeof(uint32_t));
+
+		unsigned last = (c + 1) * CHUNK_SIZE < job->count ? (c + 1) * CHUNK_SIZE : job->count;
+		for (unsigned i = c * CHUNK_SIZE; i < last; i++) {
+			const float *p = job->positions[i].data;
+			uint32_t key = hash_cell(cell(grid, p[0]), cell(grid, p[1]), cell(grid, p[2]), bits);
+			grid->keys[i] = key;
+			hist[key >> shift]++;
+		}
+	}
+}
+
+/*
+ * Scatter the points of a chunk to their partitions, keeping index order.
+ */
+static void
+scatter_chunks(void *data, unsigned begin, unsigned end)
+{
+	BuildJob *job = data;
+	SpatialGrid *grid = job->grid;
+	const unsigned shift = grid->bucket_bits - 8;
+
+	for (unsigned c = begin; c < end; c++) {
+		uint32_t cursor[SPATIAL_PARTITIONS];
+		memcpy(cursor, grid->histograms + c * SPATIAL_PARTITIONS, sizeof(cursor));
+
+		unsigned last = (c + 1) * CHUNK_SIZE < job->count ? (c + 1) * CHUNK_SIZE : job->count;
+		for (unsigned i = c * CHUNK_SIZE; i < last; i++) {
+			grid->order[cursor[grid->keys[i] >> shift]++] = i;
+		}
+	}
+}
+
+/*
+ * Counting sort of the points of a partition into its buckets.
+ */
+static void
+sort_partitions(void *data, unsigned begin, unsigned end)
+{
+	BuildJob *job = data;
+	SpatialGrid *grid = job->grid;
+	const unsigned span = 1u << (grid->bucket_bits - 8);
+
+	for (unsigned p = begin; p < end; p++) {
+		const unsigned first = p * span;
+		const unsigned from = grid->part_starts[p], to = grid->part_starts[p + 1];
+		uint32_t *starts = grid->starts + first;
+		uint32_t *cursors = grid->cursors + first;
+
+		memset(cursors, 0, span * sizeof(uint32_t));
+		for (unsigned k = from; k < to; k++) {
+			cursors[grid->keys[grid->order[k]] - first]++;
+		}
+
+		unsigned total = from;
+		for (unsigned b = 0; b < span; b++) {
+			unsigned n = cursors[b];
+			starts[b] = cursors[b] = total;
+			total += n;
+		}
+
+		for (unsigned k = from; k < to; k++) {
+			unsigned i = grid->order[k];
+			unsigned slot = cursors[grid->keys[i] - first]++;
+			const float *pos = job->positions[i].data;
+			grid->x[slot] = pos[0];
+			grid->y[slot] = pos[1];
+			grid->z[slot] = pos[2];
+			grid->ids[slot] = i;
+		}
+	}
+}
+
+int
+spatial_build(SpatialGrid *grid, const Vec *positions, unsigned count)
+{
+	if (!reserve(grid, count)) {
+		grid->count = 0;
+		return 0;
+	}
+
+	BuildJob job = { grid, positions, count };
+	unsigned chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	job_parallel_for(chunks, 1, key_chunks, &job);
+
+	// turn the histograms into the write offsets of every chunk within
+	// every partition
+	unsigned total = 0;
+	for (unsigned p = 0; p < SPATIAL_PARTITIONS; p++) {
+		grid->part_starts[p] = total;
+		for (unsigned c = 0; c < chunks; c++) {
+			uint32_t *h = &grid->histograms[c * SPATIAL_PARTITIONS + p];
+			unsigned n = *h;
+			*h = total;
+			total += n;
+		}
+	}
+	grid->part_starts[SPATIAL_PARTITIONS] = total;
+
+	job_parallel_for(chunks, 1, scatter_chunks, &job);
+	job_parallel_for(SPATIAL_PARTITIONS, 4, sort_partitions, &job);
+	grid->starts[1u << grid->bucket_bits] = count;
+	grid->count = count;
+
+	return 1;
+}
+
+unsigned
+spatial_range(
+	const SpatialGrid *grid,
+	const Vec *center,
+	float radius,
+	uint32_t *r_ids,
+	unsigned max
+) {
+	const float cx = center->data[0], cy = center->data[1], cz = center->data[2];
+	const float r2 = radius * radius;
+	unsigned found = 0;
+
+	int x0 = cell(grid, cx - radius), x1 = cell(grid, cx + radius);
+	int y0 = cell(grid, cy - radius), y1 = cell(grid, cy + radius);
+	int z0 = cell(grid, cz - radius), z1 = cell(grid, cz + radius);
+
+	// scanning everything is cheaper than visiting mostly empty cells
+	double cells = (double)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+	if (cells > grid->count) {
+		for (unsigned j = 0; j < grid->count; j++) {
+			float dx = grid->x[j] - cx, dy = grid->y[j] - cy, dz = grid->z[j] - cz;
+			if (dx * dx + dy * dy + dz * dz <= r2) {
+				if (found < max) {
+					r_ids[found] = grid->ids[j];
+				}
+				found++;
+			}
+		}
+		return found;
+	}
+
+	for (int z = z0; z <= z1; z++) {
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				if (cell_dist2(grid, x, y, z, cx, cy, cz) > r2) {
+					continue;
+				}
+				uint32_t b = hash_cell(x, y, z, grid->bucket_bits);
+				for (unsigned j = grid->starts[b]; j < grid->starts[b + 1]; j++) {
+					float dx = grid->x[j] - cx, dy = grid->y[j] - cy, dz = grid->z[j] - cz;
+					if (dx * dx + dy * dy + dz * dz > r2) {
+						continue;
+					}
+					// skip points of other cells sharing the bucket
+					if (cell(grid, grid->x[j]) != x ||
+					    cell(grid, grid->y[j]) != y ||
+					    cell(grid, grid->z[j]) != z) {
+						continue;
+					}
+					if (found < max) {
+						r_ids[found] = grid->ids[j];
+					}
+					found++;
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Max-heap of the k nearest candidates, keyed by squared distance.
+ */
+static void
+heap_sift_down(uint32_t *ids, float *dist2, unsigned n, unsigned i)
+{
+	for (;;) {
+		unsigned largest = i, l = 2 * i + 1, r = 2 * i + 2;
+		if (l < n && dist2[l] > dist2[largest]) {
+			largest = l;
+		}
+		if (r < n && dist2[r] > dist2[largest]) {
+			largest = r;
+		}
+		if (largest == i) {
+			return;
+		}
+		uint32_t id = ids[i];
+		float d = dist2[i];
+		ids[i] = ids[largest];
+		dist2[i] = dist2[largest];
+		ids[largest] = id;
+		dist2[largest] = d;
+		i = largest;
+	}
+}
+
+static void
+heap_offer(uint32_t *ids, float *dist2, unsigned k, unsigned *n, uint32_t id, float d)
+{
+	if (*n < k) {
+		// sift up
+		unsigned i = (*n)++;
+		while (i > 0 && dist2[(i - 1) / 2] < d) {
+			ids[i] = ids[(i - 1) / 2];
+			dist2[i] = dist2[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+		ids[i] = id;
+		dist2[i] = d;
+	} else if (d < dist2[0]) {
+		ids[0] = id;
+		dist2[0] = d;
+		heap_sift_down(ids, dist2, k, 0);
+	}
+}
+
+unsigned
+spatial_nearest(
+	const SpatialGrid *grid,
+	const Vec *center,
+	unsigned k,
+	uint32_t *r_ids,
+	float *r_dist2
+) {
+	const float cx = center->data[0], cy = center->data[1], cz = center->data[2];
+	const int x0 = cell(grid, cx), y0 = cell(grid, cy), z0 = cell(grid, cz);
+	unsigned found = 0;
+
+	if (k > grid->count) {
+		k = grid->count;
+	}
+	if (k == 0) {
+		return 0;
+	}
+
+	// visit shells of cells at growing Chebyshev distance, until no point
+	// outside of them can be closer than the current k-th nearest
+	for (int ring = 0;; ring++) {
+		double side = 2.0 * ring + 1;
+		if (ring > 0 && side * side * side > grid->count) {
+			// the shells got larger than the point set, scan it instead
+			found = 0;
+			for (unsigned j = 0; j < grid->count; j++) {
+				float dx = grid->x[j] - cx, dy = grid->y[j] - cy, dz = grid->z[j] - cz;
+				heap_offer(r_ids, r_dist2, k, &found, grid->ids[j], dx * dx + dy * dy + dz * dz);
+			}
+			break;
+		}
+
+		for (int z = z0 - ring; z <= z0 + ring; z++) {
+			for (int y = y0 - ring; y <= y0 + ring; y++) {
+				int on_face = abs(z - z0) == ring || abs(y - y0) == ring;
+				int step = on_face || ring == 0 ? 1 : 2 * ring;
+				for (int x = x0 - ring; x <= x0 + ring; x += step) {
+					// skip cells which can't hold anything closer
+					if (found == k && cell_dist2(grid, x, y, z, cx, cy, cz) >= r_dist2[0]) {
+						continue;
+					}
+					uint32_t b = hash_cell(x, y, z, grid->bucket_bits);
+					for (unsigned j = grid->starts[b]; j < grid->starts[b + 1]; j++) {
+						if (cell(grid, grid->x[j]) != x ||
+						    cell(grid, grid->y[j]) != y ||
+						    cell(grid, grid->z[j]) != z) {
+							continue;
+						}
+						float dx = grid->x[j] - cx, dy = grid->y[j] - cy, dz = grid->z[j] - cz;
+						heap_offer(r_ids, r_dist2, k, &found, grid->ids[j], dx * dx + dy * dy + dz * dz);
+					}
+				}
+			}
+		}
+
+		float reach = ring * grid->cell_size;
+		if (found == k && r_dist2[0] <= reach * reach) {
+			break;
+		}
+	}
+
+	// heap sort, closest first
+	for (unsigned n = found; n > 1; n--) {
+		uint32_t id = r_ids[0];
+		float d = r_dist2[0];
+		r_ids[0] = r_ids[n - 1];
+		r_dist2[0] = r_dist2[n - 1];
+		r_ids[n - 1] = id;
+		r_dist2[n - 1] = d;
+		heap_sift_down(r_ids, r_dist2, n - 1, 0);
+	}
+
+	return found;
+}
+
+typedef struct PairJob {
+	const SpatialGrid *grid;
+	float r2;
+	uint32_t *offsets;
+	SpatialPair *pairs;
+	unsigned max;
+} PairJob;
+
+/*
+ * Count or, once offsets are known, write the pairs whose first point lies in
+ * a chunk of buckets.
+ */
+static void
+pair_chunks(void *data, unsigned begin, unsigned end)
+{
+	PairJob *job = data;
+	const SpatialGrid *grid = job->grid;
+
+	for (unsigned c = begin; c < end; c++) {
+		unsigned first = grid->starts[c * PAIR_CHUNK_BUCKETS];
+		unsigned last = grid->starts[(c + 1) * PAIR_CHUNK_BUCKETS];
+		unsigned n = 0, out = job->pairs ? job->offsets[c] : 0;
+
+		for (unsigned i = first; i < last; i++) {
+			const float px = grid->x[i], py = grid->y[i], pz = grid->z[i];
+			const int x0 = cell(grid, px), y0 = cell(grid, py), z0 = cell(grid, pz);
+
+			for (int z = z0 - 1; z <= z0 + 1; z++) {
+				for (int y = y0 - 1; y <= y0 + 1; y++) {
+					for (int x = x0 - 1; x <= x0 + 1; x++) {
+						if (cell_dist2(grid, x, y, z, px, py, pz) > job->r2) {
+							continue;
+						}
+						uint32_t b = hash_cell(x, y, z, grid->bucket_bits);
+						unsigned j = grid->starts[b] > i + 1 ? grid->starts[b] : i + 1;
+						for (; j < grid->starts[b + 1]; j++) {
+							float dx = grid->x[j] - px, dy = grid->y[j] - py, dz = grid->z[j] - pz;
+							if (dx * dx + dy * dy + dz * dz > job->r2) {
+								continue;
+							}
+							if (cell(grid, grid->x[j]) != x ||
+							    cell(grid, grid->y[j]) != y ||
+							    cell(grid, grid->z[j]) != z) {
+								continue;
+							}
+							if (job->pairs && out + n < job->max) {
+								uint32_t a = grid->ids[i], b = grid->ids[j];
+								job->pairs[out + n].a = a < b ? a : b;
+								job->pairs[out + n].b = a < b ? b : a;
+							}
+							n++;
+						}
+					}
+				}
+			}
+		}
+
+		if (!job->pairs) {
+			job->offsets[c] = n;
+		}
+	}
+}
+
+unsigned
+spatial_pairs(SpatialGrid *grid, float radius, SpatialPair *r_pairs, unsigned max)
+{
+	if (radius > grid->cell_size || grid->count == 0) {
+		return 0;
+	}
+
+	unsigned buckets = 1u << grid->bucket_bits;
+	unsigned chunks = (buckets + PAIR_CHUNK_BUCKETS - 1) / PAIR_CHUNK_BUCKETS;
+	PairJob job = { grid, radius * radius, grid->pair_offsets, NULL, max };
+
+	// count, then write at the per-chunk offsets so that the output does not
+	// depend on scheduling
+	job_parallel_for(chunks, 1, pair_chunks, &job);
+	unsigned total = 0;
+	for (unsigned c = 0; c < chunks; c++) {
+		unsigned n = job.offsets[c];
+		job.offsets[c] = total;
+		total += n;
+	}
+	if (r_pairs && max > 0) {
+		job.pairs = r_pairs;
+		job_parallel_for(chunks, 1, pair_chunks, &job);
+	}
+
+	return total;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "matlib.h"
+#include <stdint.h>
+
+/*******************************************************************************
+ * Spatial hash grid.
+ *
+ * Points are bucketed into a uniform grid of cubic cells over unbounded space,
+ * each cell being hashed to one of a power-of-two number of buckets. The grid
+ * is rebuilt from scratch every frame with a parallel counting sort, which
+ * stores the points bucket after bucket in SoA arrays, in index order within
+ * each bucket, so that rebuilds and queries are deterministic.
+ *
+ * Cells sharing a bucket are told apart by recomputing the cell of each
+ * point, so that queries never report a point twice.
+*******************************************************************************/
+
+#define SPATIAL_PARTITIONS 256
+
+/**
+ * SpatialPair - Indices of two points closer than the query radius, `a < b`.
+ */
+typedef struct SpatialPair {
+	uint32_t a, b;
+} SpatialPair;
+
+/**
+ * SpatialGrid - Sorted point storage of a uniform hash grid.
+ */
+typedef struct SpatialGrid {
+	float cell_size;
+	float inv_cell_size;
+
+	// bucket b holds the sorted points [starts[b], starts[b + 1])
+	unsigned bucket_bits;
+	uint32_t *starts;
+
+	// points in bucket order, in SoA layout
+	float *x, *y, *z;
+	uint32_t *ids;
+	unsigned count;
+	unsigned capacity;
+
+	// build scratch: bucket of every input point, points in partition
+	// order, per-chunk partition histograms and bucket cursors, and the
+	// output offsets of the bucket chunks of spatial_pairs()
+	uint32_t *keys;
+	uint32_t *order;
+	uint32_t *histograms;
+	uint32_t *cursors;
+	uint32_t *pair_offsets;
+	unsigned chunk_capacity;
+	unsigned part_starts[SPATIAL_PARTITIONS + 1];
+} SpatialGrid;
+
+/**
+ * Set up an empty grid of cells of given size. Returns 1 on success, 0 on
+ * invalid size.
+ */
+int
+spatial_init(SpatialGrid *grid, float cell_size);
+
+void
+spatial_free(SpatialGrid *grid);
+
+/**
+ * Rebuild the grid out of `count` positions, on the worker threads.
+ *
+ * Returns 1 on success, 0 if the storage could not be grown.
+ */
+int
+spatial_build(SpatialGrid *grid, const Vec *positions, unsigned count);
+
+/**
+ * Find the points within `radius` of `center`.
+ *
+ * Writes up to `max` indices to `r_ids` and returns the number of points
+ * found, which may exceed `max`.
+ */
+unsigned
+spatial_range(
+	const SpatialGrid *grid,
+	const Vec *center,
+	float radius,
+	uint32_t *r_ids,
+	unsigned max
+);
+
+/**
+ * Find the `k` points nearest to `center`, closest first.
+ *
+ * Writes the indices to `r_ids` and the squared distances to `r_dist2`.
+ * Returns the number of points found, less than `k` only when the
+ * grid holds fewer points.
+ */
+unsigned
+spatial_nearest(
+	const SpatialGrid *grid,
+	const Vec *center,
+	unsigned k,
+	uint32_t *r_ids,
+	float *r_dist2
+);
+
+/**
+ * Find all pairs of points within `radius` of each other, on the worker
+ * threads. `radius` must not exceed the cell size.
+ *
+ * Writes up to `max` pairs to `r_pairs`, ordered by bucket, and returns the
+ * number of pairs found, which may exceed `max`, or 0 on failure.
+ */
+unsigned
+spatial_pairs(SpatialGrid *grid, float radius, SpatialPair *r_pairs, unsigned max);